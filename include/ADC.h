@@ -2,7 +2,52 @@
 #ifndef _ADC_H
 #define _ADC_H
 
+#include "STD_TYPES.h"
+
+#define ADC_SCAN_MAX 4 // max number of channels in the scan list
+
+typedef struct
+{
+	u16 value; // conversion result
+	u16 tick;  // low 16 bits of TIMER0_Ticks when the conversion completed
+} ADC_Sample_t;
+
 void ADC_Init(void);      // ADC Initialization And Enable
-unsigned short int ADC_Read(unsigned char channel); // Read From The ADC Channel
+unsigned short int ADC_Read(unsigned char channel); // Read From The ADC Channel (blocking, dont use while scanning)
+
+/* SCAN ENGINE
+One conversion per timer0 overflow: ADC_Tick marks it due and the main
+loop starts it when it goes to sleep, inside ADC noise reduction sleep when
+it can (see power.h); if the main loop stays busy for a whole tick the next
+ADC_Tick starts it. ADC_vect stores the result and moves ADMUX to the next
+channel of the list. The first
+conversion after each ADMUX switch is thrown away. Results are double
+buffered, the front buffer always holds one complete scan.
+*/
+void ADC_ScanStart(const u8 *channels, u8 count);
+u8 ADC_GetSample(u8 channel, ADC_Sample_t *sample); // copy of the latest sample, returns 0 if channel is not scanned
+u16 ADC_ReadLatest(u8 channel);                     // latest value of a scanned channel (non blocking)
+u8 ADC_ScanSeq(void);                               // incremented each time a full scan is published
+u8 ADC_ScanReady(void);                             // 1 once the first full scan is published
+void ADC_Tick(void);                                // call from the timer0 ISR
+u8 ADC_TakeDue(void);                               // interrupts off: 1 if the caller has to start a conversion
+void ADC_Convert(void);                             // starts it without sleeping
+
+/* OVERSAMPLING
+One scanned channel can be oversampled. It gets its own rate: the scan
+visits it after every other channel, so with 3 channels every third tick
+(49ms) instead of once a scan. No tick is spent on a discard when switching
+to it, the first conversion of the visit is thrown away instead; the ADC
+then free runs for ADC_OS_BURST conversions (the CPU sleeps in idle mode
+meanwhile), a boxcar decimator sums 2^os_log2 conversions into one output
+with extra_bits more resolution (4x oversampling per extra bit, needs ~1 LSB
+of noise). ADC_GetSample returns the latest decimated value for that
+channel, a new one every 2^os_log2 / ADC_OS_BURST visits, counted by
+ADC_OversampleSeq. Call after ADC_ScanStart, the channel must be in the list.
+*/
+#define ADC_OS_BURST 64 // conversions per visit, 65 * 104us (125kHz ADC clock) fits in one timer0 tick
+
+void ADC_Oversample(u8 channel, u8 os_log2, u8 extra_bits); // os_log2 6..8, extra_bits <= os_log2 / 2
+u8 ADC_OversampleSeq(void);                                  // incremented on each decimated output
 
 #endif /* ADC_INITIALIZATION_H_ */
@@ -2,6 +2,8 @@
 #ifndef DIO_H
 #define DIO_H
 
+#include "hal.h"
+
 
 /* Directions */
 #define INPUT 0
@@ -19,5 +21,40 @@ unsigned char DIO_ReadPin(char PortName, unsigned char PinNum);
 
 unsigned char DIO_ReadPort(char PortName);
 
+/* COMPILE TIME PIN ACCESS
+A pin is described by its port letter and bit, e.g.
+#define HEATER_IO B, 5
+The register is resolved by the preprocessor so each access compiles to
+a single sbi/cbi/sbic/sbis instead of a call and a switch; avrbench
+(lcd_senddata, pushbuttons_tick) measures what that saves.
+*/
+#define DIO_PIN_OUTPUT(pin) _DIO_DDR_SET(pin)
+#define DIO_PIN_INPUT(pin) _DIO_DDR_CLR(pin)
+#define DIO_PIN_HIGH(pin) _DIO_PORT_SET(pin)
+#define DIO_PIN_LOW(pin) _DIO_PORT_CLR(pin)
+#define DIO_PIN_WRITE(pin, value) _DIO_PORT_WRITE(pin, value)
+#define DIO_PIN_READ(pin) _DIO_PIN_GET(pin)
+
+// Whole port registers from a port letter
+#define DIO_DDR(prt) _DIO_CAT(DDR, prt)
+#define DIO_PORT(prt) _DIO_CAT(PORT, prt)
+#define DIO_PINS(prt) _DIO_CAT(PIN, prt)
+
+// second expansion step, splits "B, 5" into two arguments
+#define _DIO_CAT(a, b) a##b
+#define _DIO_DDR_SET(prt, bit) (DDR##prt |= (1 << (bit)))
+#define _DIO_DDR_CLR(prt, bit) (DDR##prt &= ~(1 << (bit)))
+#define _DIO_PORT_SET(prt, bit) (PORT##prt |= (1 << (bit)))
+#define _DIO_PORT_CLR(prt, bit) (PORT##prt &= ~(1 << (bit)))
+#define _DIO_PIN_GET(prt, bit) ((PIN##prt >> (bit)) & 0x01)
+#define _DIO_PORT_WRITE(prt, bit, value) \
+    do                                   \
+    {                                    \
+        if (value)                       \
+            PORT##prt |= (1 << (bit));   \
+        else                             \
+            PORT##prt &= ~(1 << (bit));  \
+    } while (0)
+
 
 #endif /* DIO_H */
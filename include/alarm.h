@@ -0,0 +1,42 @@
+#ifndef _ALARM_H
+#define _ALARM_H
+
+#include "STD_TYPES.h"
+
+/* ALARM ANNUNCIATOR
+Each alarm has a slot; slot 0 has the highest priority. The sensing code
+only reports conditions with ALARM_Set, ALARM_Tick (timer0 ISR) plays the
+buzzer and lamp patterns of the highest priority audible alarm. The UI
+shows ALARM_Message and calls ALARM_Snooze/ALARM_Acknowledge.
+*/
+
+// SLOTS, in priority order
+#define ALARM_SLOT_WEIGHT 0 // max weight exceeded, high priority
+#define ALARM_SLOT_EXIT 1   // patient left the bed in sleep mode, high priority
+#define ALARM_SLOT_FEVER 2  // high fever, medium priority
+#define ALARM_SLOTS 3
+
+// SLOT STATES
+#define ALARM_INACTIVE 0
+#define ALARM_ACTIVE 1  // condition present and sounding
+#define ALARM_SNOOZED 2 // silenced for ALARM_SNOOZE_TICKS
+#define ALARM_ACKED 3   // silenced until the condition clears
+
+#define ALARM_SNOOZE_TICKS 3662 // ~60s of timer0 ticks
+
+/* PATTERN STEPS
+one byte per step: bit 7 output on, bits 0..6 duration in ticks, 0 ends the pattern
+*/
+#define ALARM_ON(ticks) (0x80 | (ticks))
+#define ALARM_OFF(ticks) (ticks)
+
+void ALARM_Init(void);
+void ALARM_Set(u8 slot, u8 condition); // raise or clear an alarm condition
+void ALARM_Tick(void);                 // call from the timer0 ISR
+void ALARM_Snooze(void);               // silences the sounding alarms for a while
+void ALARM_Acknowledge(void);          // silences active alarms until they clear
+u8 ALARM_Sounding(void);               // 1 if any alarm is audible
+u8 ALARM_Active(void);                 // 1 if any alarm condition is present
+const char *ALARM_Message(void);       // flash text of the highest active alarm, 0 if none
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef _BED_H
+#define _BED_H
+
+#include "STD_TYPES.h"
+#include "sensor.h"
+#include "heater.h"
+#include "bedexit.h"
+
+/* BED LOGIC
+Weight, fever and heater rules, occupancy and mode changes of one bed, on
+a context instead of globals so a host harness can run many beds (see
+tools/wardsim.c). No hardware access: callers feed converted sensor values
+in and drive the relays, servo and annunciator from the results.
+*/
+
+#define BED_MAX_WEIGHT 150          // if exceeded the weight alarm is raised
+#define BED_EXIT_SENSITIVITY BEDEXIT_MEDIUM // bed exit detector limit
+#define BED_FEVER_TEMP SENSOR_DC(37) // body temperature alarm level
+#define BED_FEVER_BAND 2            // 0.2 C, fever clears below 36.8
+
+// MODES
+#define BED_MODE_SIT 0
+#define BED_MODE_SLEEP 1
+
+// POSTURE MOVES, returned by BED_Control
+#define BED_MOVE_NONE 0
+#define BED_MOVE_SIT 1
+#define BED_MOVE_SLEEP 2
+
+typedef struct
+{
+    // WEIGHT
+    u16 weight;      // current measured weight
+    u8 alarm_weight; // set while the weight exceeds BED_MAX_WEIGHT
+    u16 occupancy;   // 100ms steps the bed has been occupied
+    BEDEXIT_t exit;  // occupancy from every load cell sample
+    u8 alarm_exit;   // set when the patient left the bed in sleep mode
+
+    // TEMPERATURE, 0.1 C
+    temp_dC_t body;
+    temp_dC_t room;
+    u8 alarm_fever;
+    SENSOR_Filter_t body_filter; // median of 3 then ~1.6s smoothing at the 100ms rate
+    SENSOR_Filter_t room_filter;
+
+    // HEATER
+    u16 heater_threshold; // room setpoint in C
+    u8 heater_enable;
+    u8 heater_state; // relay
+    HEATER_t heater;
+
+    // LAMP
+    u8 lamp_enable;
+    u8 lamp_state;
+
+    // MODE, a change of mode_new is carried out by BED_Control
+    u8 mode_old;
+    u8 mode_new;
+
+    u8 alarms; // bit per ALARM_SLOT, as of the last BED_Sense
+} BED_t;
+
+/* PUBLISHED STATE
+The control tasks publish the bed once per cycle with BED_Publish, the UI
+and the log take a copy with BED_Snapshot. The sequence is odd while a
+publish is in progress; a reader that saw it odd or changed copies again,
+so copies are never torn and nobody turns interrupts off. A reader must
+not interrupt the writer (no BED_Snapshot from an ISR that can preempt
+BED_Publish), it would spin forever.
+*/
+typedef struct
+{
+    u16 weight;
+    u16 occupancy;
+    temp_dC_t body;
+    temp_dC_t room;
+    u16 heater_duty; // window steps
+    u16 heater_threshold;
+    u8 heater_enable;
+    u8 heater_state;
+    u8 lamp_enable;
+    u8 lamp_state;
+    u8 mode;
+    u8 alarms;
+} BED_View_t;
+
+typedef struct
+{
+    volatile u8 seq; // odd while publishing
+    BED_View_t view;
+} BED_Shared_t;
+
+void BED_Init(BED_t *b);
+// each new load cell sample (~49ms), returns the BEDEXIT_EV_* detected
+u8 BED_Weigh(BED_t *b, u16 weight);
+// each 100ms with the weight and unfiltered temperatures, returns the alarm bits that changed
+u8 BED_Sense(BED_t *b, u16 weight, temp_dC_t body, temp_dC_t room);
+u8 BED_Heater(BED_t *b);        // each 100ms after BED_Sense, returns the heater relay state
+u8 BED_Control(BED_t *b);       // each 1s, returns the BED_MOVE_* to carry out
+u8 BED_Lamp(const BED_t *b);    // lamp relay state, unless the annunciator owns the lamp
+void BED_Publish(const BED_t *b, BED_Shared_t *s);
+void BED_Snapshot(const BED_Shared_t *s, BED_View_t *v); // consistent copy of the last publish
+
+#endif
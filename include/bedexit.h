@@ -0,0 +1,61 @@
+#ifndef _BEDEXIT_H
+#define _BEDEXIT_H
+
+#include "STD_TYPES.h"
+
+/* BED EXIT DETECTOR
+Two one sided CUSUM tests on the load cell weight, fed with every new
+sample (the scan visits the load cell every third tick, 49ms, each sample
+the mean of 64 conversions). Time constants below are at that rate.
+
+Occupied: the reference is the patient's weight and the test sums how far
+each sample falls under half of it, S = max(0, S + ref / 2 - w). A patient
+getting up drives S over the limit within a few samples, while rolling,
+sitting up or leaning on a rail leaves most of the weight on the bed and S
+at 0. The reference is the weight the patient settled at after getting in
+and then only follows drift over minutes, so a visitor sitting on the
+edge for a while and getting up is not mistaken for the patient leaving.
+
+Empty: S = max(0, S + w - BEDEXIT_ENTRY_KG), over BEDEXIT_ENTRY_SUM is an
+entry. After an exit it waits for the weight to go under BEDEXIT_ENTRY_KG,
+so the rest of the exit is not an entry, or for ~3s over it (the patient
+sat down on the edge and lay back).
+
+The exit limit is the sensitivity, in 64ths of the patient's weight times
+samples so light and heavy patients are detected equally fast: lower reacts
+sooner to slow exits and is fooled more easily. No hardware access,
+tools/bedexit_replay.c replays synthetic traces through it.
+*/
+
+#define BEDEXIT_ENTRY_KG 10   // occupied above this
+#define BEDEXIT_ENTRY_SUM 30  // entry limit, kg * samples
+#define BEDEXIT_MAX_KG 255    // samples clipped here
+#define BEDEXIT_SETTLE 61     // samples (3s) of fast reference tracking after an entry, or of waiting after an exit
+#define BEDEXIT_REF_FAST 2    // reference smoothing shifts, 4 samples (200ms) while settling
+#define BEDEXIT_REF_SLOW 12   // 4096 samples (200s) afterwards
+
+// SENSITIVITY
+#define BEDEXIT_LOW 0
+#define BEDEXIT_MEDIUM 1
+#define BEDEXIT_HIGH 2
+#define BEDEXIT_LEVELS 3
+
+// EVENTS
+#define BEDEXIT_EV_NONE 0
+#define BEDEXIT_EV_EXIT 1
+#define BEDEXIT_EV_ENTRY 2
+
+typedef struct
+{
+    u8 occupied;
+    u8 limit;  // exit limit, 64ths of the patient weight * samples
+    u8 settle; // samples left of fast tracking or of waiting
+    s16 sum;   // CUSUM of the current test
+    u32 ref;   // patient weight in kg << 16
+} BEDEXIT_t;
+
+void BEDEXIT_Init(BEDEXIT_t *d, u8 sensitivity); // starts empty, a patient on the bed reads as an entry
+void BEDEXIT_SetSensitivity(BEDEXIT_t *d, u8 sensitivity);
+u8 BEDEXIT_Step(BEDEXIT_t *d, u16 weight); // each new sample in kg, returns a BEDEXIT_EV_*
+
+#endif
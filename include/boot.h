@@ -0,0 +1,34 @@
+#ifndef _BOOT_H
+#define _BOOT_H
+
+#include "STD_TYPES.h"
+
+/* BOOT SEQUENCER
+The control loop starts first, slow peripherals come up afterwards as
+steps polled once per tick from a task, all of them side by side. A step
+returns 1 when it is done and is not called again. Each phase records the
+ms since reset when it finished, BOOT_ShowPage draws them.
+*/
+
+typedef u8 (*BOOT_Step_fn)(void);
+
+typedef struct
+{
+    BOOT_Step_fn step;
+    const char *name; // flash, short, for the diagnostics page
+    u16 done_ms;      // 0 while running
+} BOOT_Step_t;
+
+#define BOOT_STEP(fn, name) {fn, name, 0}
+
+extern u8 BOOT_ResetFlags; // MCUSR at reset (1 power on, 2 external, 4 brownout, 8 watchdog)
+
+void BOOT_Init(BOOT_Step_t *steps, u8 count); // call once the control loop runs, records its start
+void BOOT_Run(void);                          // polls the unfinished steps, call each tick
+u8 BOOT_StepDone(u8 index);
+u8 BOOT_Done(void);
+void BOOT_UiReady(void); // records the first usable screen
+u16 BOOT_Ms(void);       // ms since reset, saturates
+void BOOT_ShowPage(void);
+
+#endif
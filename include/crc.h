@@ -0,0 +1,14 @@
+#ifndef _CRC_H
+#define _CRC_H
+
+#include "STD_TYPES.h"
+
+/* CRC-16/CCITT-FALSE
+poly 0x1021, init 0xffff, no reflection, table free (a few shifts per byte)
+*/
+#define CRC16_INIT 0xffff
+
+u16 CRC16_Update(u16 crc, u8 data);
+u16 CRC16_Block(u16 crc, const void *data, u8 len);
+
+#endif
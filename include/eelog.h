@@ -0,0 +1,69 @@
+#ifndef _EELOG_H
+#define _EELOG_H
+
+#include "STD_TYPES.h"
+#include "eeprom.h"
+#include "sensor.h"
+
+/* EEPROM TREND LOG
+Circular log over EEPROM_LOG_START..EEPROM_SIZE in EELOG_PAGE_SIZE pages.
+Each page starts with a header holding the lap bit, which flips each time
+the log wraps, so the newest page is found with a binary search over the
+page headers. Pages are written in turn, spreading the wear evenly.
+
+Records follow the header, an 0xff byte ends the page:
+  0x10 trend, varints: minute, body, room (zigzag), weight, occupancy
+  0x2m trend delta, one zigzag varint for each field set in mask m
+       (1 body, 2 room, 4 weight, 8 occupancy), minute + 1
+  0x3e event e, value byte, varint minute
+The first trend of a page and after boot is absolute. A record is written
+back to front with its tag last, so a reset mid record leaves the page
+ending before it.
+*/
+
+#define EELOG_PAGE_SIZE 32
+#define EELOG_PAGES ((EEPROM_SIZE - EEPROM_LOG_START) / EELOG_PAGE_SIZE)
+
+// RECORD TYPES
+#define EELOG_REC_TREND 1
+#define EELOG_REC_EVENT 2
+
+// EVENTS
+#define EELOG_EV_BOOT 0      // value: MCUSR reset flags
+#define EELOG_EV_ALARM_ON 1  // value: alarm slot
+#define EELOG_EV_ALARM_OFF 2 // value: alarm slot
+
+typedef struct
+{
+    temp_dC_t body;
+    temp_dC_t room;
+    u16 weight;
+    u16 occupancy;
+} EELOG_Trend_t;
+
+typedef struct
+{
+    u8 type;  // EELOG_REC_*
+    u8 event; // EELOG_EV_* for events
+    u8 value; // event value
+    u16 minute; // minutes since the boot that wrote it
+    EELOG_Trend_t trend; // trend records
+} EELOG_Record_t;
+
+// Sequential reader, oldest record first
+typedef struct
+{
+    u8 page;
+    u8 offset;
+    u8 pages_left;
+    EELOG_Trend_t last; // previous trend of the page, for deltas
+    u16 minute;
+} EELOG_Cursor_t;
+
+void EELOG_Init(void); // finds the head, O(log EELOG_PAGES) header reads
+u8 EELOG_Trend(const EELOG_Trend_t *trend); // once a minute, returns 0 if dropped
+u8 EELOG_Event(u8 event, u8 value);
+void EELOG_Rewind(EELOG_Cursor_t *c);
+u8 EELOG_Next(EELOG_Cursor_t *c, EELOG_Record_t *r); // returns 0 at the end of the log
+
+#endif
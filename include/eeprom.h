@@ -0,0 +1,28 @@
+#ifndef _EEPROM_H
+#define _EEPROM_H
+
+#include "STD_TYPES.h"
+
+/* NON BLOCKING EEPROM WRITES
+Writes are queued as (address, byte) pairs and programmed one by one from
+the EEPROM ready interrupt (~3.4ms each), bytes that already hold the value
+are skipped to save wear. Reads wait only for a write in progress and see
+the queued values. Queue order is write order.
+*/
+
+#define EEPROM_SIZE 1024
+#define EEPROM_QUEUE_SIZE 32 // power of 2
+
+// LAYOUT
+#define EEPROM_SETTINGS_START 0x000 // settings block, up to 0x03F
+#define EEPROM_LOG_START 0x040      // trend log, to the end
+
+void EEPROM_Init(void);
+u8 EEPROM_Read(u16 addr);
+void EEPROM_ReadBlock(u16 addr, u8 *dst, u8 len);
+u8 EEPROM_Write(u16 addr, u8 data);                  // returns 0 if the queue is full
+u8 EEPROM_WriteBlock(u16 addr, const u8 *src, u8 len); // all or nothing, returns 0 if it does not fit
+u8 EEPROM_Free(void);                                // free queue entries
+u8 EEPROM_Busy(void);                                // 1 while writes are pending
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _HAL_H
+#define _HAL_H
+
+/* HARDWARE ABSTRACTION
+On the target this is just the avr-libc headers. Building with HAL_NATIVE
+swaps them for hal_sim.h, where the registers, interrupts and delays are
+simulated on a Linux host with virtual time (see src/hal_sim.c).
+*/
+
+#ifdef HAL_NATIVE
+
+#include "hal_sim.h"
+
+#else
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+
+// Main loop has nothing ready, sleeps until an interrupt (see power.h)
+void PWR_Idle(void);
+#define HAL_Idle() PWR_Idle()
+
+// Sleep in an SMCR mode, call with interrupts off, sei and sleep run back to back
+#define HAL_Sleep(mode)                                         \
+    do                                                          \
+    {                                                           \
+        SMCR = ((mode) << 1) | 1; /* SM2..0, SE */              \
+        __asm__ __volatile__("sei\n\tsleep" ::: "memory");     \
+        SMCR = 0;                                               \
+    } while (0)
+#define HAL_SLEEP_STOPS_IO 1 // clkIO stops in ADC noise reduction
+
+// Compiler barrier, memory accesses are not moved or cached across it
+#define HAL_Barrier() __asm__ __volatile__("" ::: "memory")
+
+#endif
+
+#endif
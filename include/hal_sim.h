@@ -0,0 +1,86 @@
+#ifndef _HAL_SIM_H
+#define _HAL_SIM_H
+
+/* SIMULATED ATMEGA328P FOR HOST BUILDS
+Plain registers are variables, registers with side effects (ADC start,
+free running counters) go through accessors that update them from the
+virtual clock. Interrupts are delivered whenever virtual time advances,
+which happens in the delays and in HAL_Sleep.
+*/
+
+#include <stdint.h>
+
+#define HAL_SIM_F_CPU 16000000UL
+
+// PORTS
+extern volatile uint8_t DDRB, DDRC, DDRD;
+extern volatile uint8_t PORTB, PORTC, PORTD;
+extern volatile uint8_t PINB, PINC, PIND;
+
+// ADC
+extern volatile uint8_t ADCSRB, ADMUX, DIDR0;
+extern volatile uint16_t ADC;
+volatile uint8_t *HAL_SimAdcsra(void);
+#define ADCSRA (*HAL_SimAdcsra())
+
+// TIMERS
+extern volatile uint8_t TCCR0A, TCCR0B, TIMSK0, TIFR0;
+extern volatile uint8_t TCCR1A, TCCR1B, TIMSK1, TIFR1;
+extern volatile uint16_t OCR1A, OCR1B;
+extern volatile uint8_t TCCR2A, TCCR2B, OCR2A, OCR2B;
+volatile uint8_t *HAL_SimTcnt0(void);
+volatile uint16_t *HAL_SimTcnt1(void);
+#define TCNT0 (*HAL_SimTcnt0())
+#define TCNT1 (*HAL_SimTcnt1())
+
+// EEPROM, a write takes 3.4ms of virtual time
+extern volatile uint16_t EEAR;
+volatile uint8_t *HAL_SimEecr(void);
+volatile uint8_t *HAL_SimEedr(void);
+#define EECR (*HAL_SimEecr())
+#define EEDR (*HAL_SimEedr())
+
+// USART0, transmit only, UDR0 is treated as write only
+extern volatile uint8_t UCSR0B, UCSR0C;
+extern volatile uint16_t UBRR0;
+volatile uint8_t *HAL_SimUcsr0a(void);
+volatile uint8_t *HAL_SimUdr0(void);
+#define UCSR0A (*HAL_SimUcsr0a())
+#define UDR0 (*HAL_SimUdr0())
+
+// PIN CHANGE, STATUS
+extern volatile uint8_t PCICR, PCMSK0;
+extern volatile uint8_t SREG, MCUSR, WDTCSR;
+
+// INTERRUPTS, vectors become plain functions the simulator calls
+#define ISR(vector) void vector(void)
+#define sei() (SREG |= 0x80)
+#define cli() (SREG &= (uint8_t)~0x80)
+void TIMER0_OVF_vect(void);
+void ADC_vect(void);
+void PCINT0_vect(void);
+void EE_READY_vect(void);
+void USART_UDRE_vect(void);
+
+// FLASH, host memory is flat
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_ptr(addr) (*(void *const *)(addr))
+
+// DELAYS ADVANCE VIRTUAL TIME
+void HAL_SimAdvance(uint32_t us);
+#define _delay_ms(ms) HAL_SimAdvance((uint32_t)((ms) * 1000UL))
+#define _delay_us(us) HAL_SimAdvance((uint32_t)(us))
+
+// Jumps to the next simulated event, ADC noise reduction starts a conversion
+void HAL_Sleep(uint8_t mode);
+#define HAL_SLEEP_STOPS_IO 0 // timers keep running in the simulation
+void PWR_Idle(void);
+#define HAL_Idle() PWR_Idle()
+
+// Full fence, host builds may run the bed logic on several threads
+#define HAL_Barrier() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#endif
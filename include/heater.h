@@ -0,0 +1,46 @@
+#ifndef _HEATER_H
+#define _HEATER_H
+
+#include "STD_TYPES.h"
+#include "sensor.h"
+
+/* TIME PROPORTIONED PI HEATER CONTROL
+HEATER_Run is called once per step (100ms sensing rate). A fixed point PI
+with anti windup computes the duty in window steps every HEATER_PID_STEPS,
+the relay is on for duty steps of each HEATER_WINDOW_STEPS window, at the
+start of even windows and at the end of odd ones so the on times of two
+windows merge. Duties shorter than HEATER_MIN_STEPS are dropped or rounded
+up to a full window, the relay switches at most once per window.
+
+No derivative term: the room moves a few 0.1 C steps a minute, so the
+difference of two readings 1s apart is mostly quantization. On the native
+build plant any KD on the measurement only added overshoot, and from
+8000 (Q8) the loop no longer settled within 0.3 C.
+*/
+
+// WINDOW IN STEPS
+#define HEATER_WINDOW_STEPS 300 // ~30s time proportioning window
+#define HEATER_MIN_STEPS 20     // ~2s minimum relay on and off time
+#define HEATER_PID_STEPS 10     // PI update each ~1s
+
+// GAINS IN Q8, window steps per 0.1 C (tuned on the native build thermal plant)
+#define HEATER_KP 4224 // 16.5 steps per 0.1 C
+#define HEATER_KI 12   // per PI update, integral time ~350s
+
+// CONTROLLER STATE, one per heater
+typedef struct
+{
+    s32 integral; // Q8 window steps
+    u16 output;   // PI output in window steps
+    u16 on_steps; // on time of the current window
+    u16 step;     // position in the window
+    u8 odd;       // on time at the end of the window
+    u8 pid_step;  // steps since the last PI update
+} HEATER_t;
+
+void HEATER_Init(HEATER_t *h);
+// Runs one step, returns the relay state, a disabled heater resets the controller
+u8 HEATER_Run(HEATER_t *h, temp_dC_t temp, temp_dC_t setpoint, u8 enable);
+u16 HEATER_Duty(const HEATER_t *h); // last PI output in window steps
+
+#endif
@@ -2,24 +2,63 @@
 #ifndef LCD_H
 #define LCD_H
 
+#include "STD_TYPES.h"
+
 /* LCD Modes */
 #define LCD_8BIT_MODE 0
 #define LCD_4BIT_MODE 1
 
 /* User Input */
 #define LCD_MODE LCD_4BIT_MODE
+#ifndef LCD_RW_TIED
+#define LCD_RW_TIED 0 // 1 once RW is strapped to GND (board rework), frees PD1 for the USART TXD
+#endif
+
+/* Framebuffer */
+#define LCD_ROWS 2
+#define LCD_COLS 16
+#define LCD_FLUSH_PER_TICK 4 // cells sent to the controller per LCD_Flush call
+
+#define LCD_POWERUP_MS 40 // HD44780 wait after power up before the first command
+
+/* GLYPH CACHE
+The controller has 8 CGRAM slots (character codes 0..7). A glyph is known
+by its address in flash; it is uploaded the first time it is drawn and
+stays in its slot while it is used. A new glyph takes a free slot, else the
+least recently drawn one that is not on screen, else the least recently
+drawn one.
+*/
+#define LCD_GLYPH_SLOTS 8
 
 void LCD_Init(void);
 
+// Raw bus access, only the flusher should use these after LCD_Init
 void LCD_SendCommand(unsigned char Command);
 
 void LCD_SendData(unsigned char Data);
 
+// Drawing functions below write to the RAM framebuffer only
+
 void lcd_setcursor(unsigned char x, unsigned char y);
 // void Seperate_Result (float u32Result,unsigned char * u8array_Result);
-void lcd_send_number(unsigned char numb);
+// Numbers in decimal without dividing, see NUMBER FORMATTING in lcd.c
+void lcd_send_number(u16 numb);
+void lcd_send_number32(unsigned long numb);
+// value / 10^decimals with the point (decimals up to 4), for fixed point like temp_dC_t
+void lcd_send_fixed(s16 value, unsigned char decimals);
 
 void lcd_sendstring(const char *Str);
-void send_specialcharachter(unsigned char *arr, char patternno, char x, char y);
+// Str in flash (PSTR or PROGMEM), not copied to SRAM
+void lcd_sendstring_P(const char *Str);
+// Draws an 8 byte glyph from flash at the cursor, see GLYPH CACHE
+void lcd_sendglyph_P(const unsigned char *glyph);
+void lcd_sendchar(unsigned char Data);
+void lcd_clear(void);
+// Shows msg (flash) over the first row until called with 0, the page below is kept
+void lcd_setbanner(const char *msg);
+
+// Sends changed cells to the controller, called every timer tick
+unsigned char LCD_Flush(void);
+void LCD_FlushAll(void);
 
 #endif /* LCD_H */
@@ -1,12 +1,49 @@
 #ifndef _LOADCELL_H
 #define _LOADCELL_H
 
-#include <avr/io.h>
-#include <util/delay.h>
+#include "hal.h"
 #include "ADC.h"
 #include "DIO.h"
 
-void LOADCELL_Init(void);
-float LOADCELL_ReadWeight(void);
+#define LOADCELL_ADMUX 0b00001 // ADC channel, must be in the ADC scan list
+
+// Decimation: 2^LOADCELL_OS_LOG2 conversions per weight sample, one output every
+// 2^LOADCELL_OS_LOG2 / ADC_OS_BURST visits, a visit every 3 ticks (64: ~20 per second, 256: ~5 per second)
+#define LOADCELL_OS_LOG2 6
+#define LOADCELL_EXTRA_BITS 3                      // 10 + 3 bit raw codes
+#define LOADCELL_BITS (10 + LOADCELL_EXTRA_BITS)
+
+/* CALIBRATION
+weight = (code - zero) * gain >> LOADCELL_GAIN_SHIFT in kg, rounded, a load
+under the zero reads 0. Tare takes the zero from the empty bed, span the gain
+from a known load on it. Both are kept with the settings.
+
+While the bed reads under LOADCELL_TRACK_KG the zero follows the code by one
+step each LOADCELL_TRACK_STEPS calls of LOADCELL_Track, fast enough for drift
+and too slow to eat a load. The tracked zero is not saved, a reset starts
+from the tare again.
+*/
+#define LOADCELL_GAIN_SHIFT 16
+#define LOADCELL_GAIN_DEFAULT 2731 // uncalibrated 1/24 kg per code, code / 3 on the 10 bit scale
+#define LOADCELL_SPAN_MIN 256      // codes between zero and span load, fewer is refused
+#define LOADCELL_TRACK_KG 1
+#define LOADCELL_TRACK_STEPS 10    // one code per second from the 100ms task
+
+typedef struct
+{
+    u16 zero; // code of the empty bed
+    u16 gain; // kg per code in Q(LOADCELL_GAIN_SHIFT)
+} LOADCELL_Cal_t;
+
+extern LOADCELL_Cal_t LOADCELL_Cal;
+
+void LOADCELL_Init(void);                 // call after ADC_ScanStart
+unsigned short LOADCELL_ReadRaw(void);    // latest decimated LOADCELL_BITS code
+unsigned short LOADCELL_ReadWeight(void); // kg, one multiply and shift
+
+void LOADCELL_SetCal(const LOADCELL_Cal_t *cal); // restored calibration, drops the tracked zero
+void LOADCELL_Tare(void);                        // empty bed: zero from the latest code
+u8 LOADCELL_Span(u16 kg);                        // known load on the bed: gain from the latest code, 0 if refused
+void LOADCELL_Track(void);                       // each 100ms, zero tracking while the bed reads empty
 
 #endif
\ No newline at end of file
@@ -0,0 +1,67 @@
+#ifndef _MENU_H
+#define _MENU_H
+
+#include "hal.h"
+#include "STD_TYPES.h"
+
+/* MENU ENGINE
+The screens are a table of nodes in flash, each with its text, a kind and
+the nodes keys 1 (UP) and 2 (DOWN) lead to. A small state machine walks the
+table on key presses from a task and never waits: messages move on by
+themselves when their time is up, value fields redraw when the value
+changes. Adding a screen is adding a node.
+
+Node text is a flash string, '\n' starts the second row and '%' marks where
+the field of a value or digits node goes. A value field is redrawn only when the
+value read from its getter changed. Bytes 1..7 draw icon 1..7 of the glyph
+table given to MENU_Init through the LCD glyph cache.
+*/
+
+// NODE KINDS
+#define MENU_PAGE 0    // keys 1 and 2 lead to next[0] and next[1]
+#define MENU_VALUE 1   // page with a live field, arg is the format
+#define MENU_DIGITS 2  // arg digits from keys 1..4, then action(key, number) and next[0]
+#define MENU_MESSAGE 3 // shown for arg (MENU_MS) then next[0], keys stay queued meanwhile
+#define MENU_CUSTOM 4  // action draws on entry (key 0) and handles every key
+
+#define MENU_REPEAT 1 // custom node arg: a held key repeats, elsewhere it is a single press
+
+// VALUE FORMATS
+#define MENU_FMT_NUMBER 0 // u16
+#define MENU_FMT_TEMP 1   // temp_dC_t, one decimal
+
+#define MENU_VALUE_TICKS 6 // live fields are read at the sensing rate (100ms)
+
+// NEXT NODE CODES, besides node indexes
+#define MENU_NEXT 0xfc // from an action: the node from the table
+#define MENU_OFF 0xfd  // screen cleared, no more input
+#define MENU_BACK 0xfe // to the node MENU_Call was made from
+#define MENU_STAY 0xff // key ignored
+
+#define MENU_MS(ms) ((ms) / 100)  // message time in the node, 100ms steps
+#define MENU_HOLD_MS 200          // last digit stays visible before moving on
+
+typedef u8 (*MENU_Action_fn)(u8 key, u16 number); // returns the next node or MENU_NEXT
+typedef u16 (*MENU_Value_fn)(void); // signed formats cast back
+
+typedef struct
+{
+    const char *text;      // flash
+    u8 kind;
+    u8 arg;
+    u8 next[2];
+    MENU_Action_fn action; // optional, runs on a key before moving
+    MENU_Value_fn value;   // MENU_VALUE only
+} MENU_Node_t;
+
+#define MENU_NODE(text, kind, arg, next1, next2, action, value) {text, kind, arg, {next1, next2}, action, value}
+
+void MENU_Init(const MENU_Node_t *nodes, const u8 (*glyphs)[8], u8 node); // tables in flash, shows the first node
+void MENU_Goto(u8 node);
+void MENU_Call(u8 node); // MENU_BACK from there returns to the current node, kept if node is already shown
+u8 MENU_Input(void);     // 1 while the node takes keys
+void MENU_Key(u8 key);   // one press of key 1..4
+void MENU_Repeat(u8 key); // auto repeat of a held key, only nodes with MENU_REPEAT take it
+void MENU_Poll(void);    // message times and live fields, call each tick
+
+#endif
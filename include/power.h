@@ -0,0 +1,37 @@
+#ifndef _POWER_H
+#define _POWER_H
+
+#include "STD_TYPES.h"
+
+/* POWER MANAGER
+HAL_Idle lands here when no task is ready: the CPU sleeps until the next
+interrupt (timer0 tick, pin change, ADC complete, USART, EEPROM ready).
+Idle mode only stops the CPU clock. ADC Noise Reduction mode also stops
+clkIO, so timer0, timer1, the USART and the servo PWM stop with it; it is
+only used for the scan conversion of the tick, which entering the mode
+starts, and only while the USART and the servo are quiet. The timer0
+counts lost meanwhile are put back.
+*/
+
+// SLEEP MODES (SMCR SM2..0)
+#define PWR_MODE_IDLE 0
+#define PWR_MODE_ADCNR 1
+#define PWR_MODES 2
+
+// ADC CONVERSION TIME (13 ADC clocks at 16MHz / 128) IN THE STOPPED TIMERS
+#define PWR_ADCNR_T0_EIGHTHS 13 // 1.625 timer0 counts (64us)
+#define PWR_ADCNR_T1_COUNTS 26  // timer1 counts (4us)
+
+typedef struct
+{
+    u32 sleeps;
+    u32 ticks; // time asleep, whole timer0 ticks
+    u16 frac;  // and timer1 counts (4096 per tick)
+} PWR_Residency_t;
+
+extern PWR_Residency_t PWR_Residency[PWR_MODES];
+
+void PWR_Idle(void);     // sleeps until the next interrupt, main loop only
+void PWR_ShowPage(void); // residency of each mode on the LCD framebuffer
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include "STD_TYPES.h"
+#include "timer.h"
+
+/* ISR AND CODE REGION PROFILER
+Regions are timed with the free running timer1 (4us counts) and keep
+min, max, mean and a log2 histogram in SRAM (PROF_Regions, readable from
+simavr or a debugger). PROF_ShowPage draws them on the LCD.
+*/
+#define PROFILER_EN 1
+
+// REGIONS
+#define PROF_ISR_TIMER0 0   // timer0 overflow ISR body
+#define PROF_TICK_LATENCY 1 // timer0 ISR start after the overflow
+#define PROF_TICK_JITTER 2  // deviation of the ISR period from 16.384ms
+#define PROF_ISR_ADC 3
+#define PROF_ISR_PCINT0 4
+#define PROF_ISR_UDRE 5     // one telemetry byte to the USART
+#define PROF_TLM 6          // encoding and queueing one telemetry record
+#define PROF_TASK0 7        // scheduler task i is region PROF_TASK0 + i
+#define PROF_TASKS_MAX 7
+#define PROF_REGIONS (PROF_TASK0 + PROF_TASKS_MAX)
+
+#define PROF_BUCKETS 12 // bucket 0: 0, bucket b: 2^(b-1)..2^b-1 counts, last: 1024 counts (4ms) and up
+
+typedef struct
+{
+    u16 min;
+    u16 max;
+    u32 sum;
+    u16 count;
+    u16 hist[PROF_BUCKETS]; // saturating
+} PROF_Region_t;
+
+extern PROF_Region_t PROF_Regions[PROF_REGIONS];
+
+#if PROFILER_EN
+#define PROF_ENTER() u16 prof_start = TIMER1_Now()
+#define PROF_EXIT(region) PROF_Record((region), TIMER1_Now() - prof_start)
+#define PROF_TICK() PROF_TickEntry()
+#else
+#define PROF_ENTER()
+#define PROF_EXIT(region)
+#define PROF_TICK()
+#endif
+
+void PROF_Reset(void);
+void PROF_Record(u8 region, u16 time);
+void PROF_TickEntry(void); // first thing in the timer0 ISR, records latency and jitter
+void PROF_ShowPage(u8 region); // draws one region on the LCD framebuffer
+
+#endif
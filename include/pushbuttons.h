@@ -2,16 +2,42 @@
 #define _PUSHBUTTONS_H
 
 // PIN DEFINITIONS
-#define PUSHBUTTON_PRT 'B'
+#define PUSHBUTTON_PRT B
 #define PUSHBUTTON_PIN_UP 0 //6
 #define PUSHBUTTON_PIN_DN 1 //5
 #define PUSHBUTTON_PIN_LEFT 2 //4
 #define PUSHBUTTON_PIN_RIGHT 3 //2
+#define PUSHBUTTON_MASK ((1 << PUSHBUTTON_PIN_UP) | (1 << PUSHBUTTON_PIN_DN) | (1 << PUSHBUTTON_PIN_LEFT) | (1 << PUSHBUTTON_PIN_RIGHT))
 
-#define DEBOUNCE_DELAY_MS 20
 #define KEYPAD_NO_PRESSED_KEY 0xff
+
+// TIMING IN TIMER0 TICKS (16ms)
+#define PUSHBUTTONS_LONG_TICKS 61   // held ~1s gives a long press event
+#define PUSHBUTTONS_REPEAT_TICKS 12 // then a repeat event each ~200ms
+
+/* EVENTS
+high nibble is the event type, low nibble the key (1 UP, 2 DOWN, 3 LEFT, 4 RIGHT)
+0 means the queue is empty
+*/
+#define PUSHBUTTONS_EV_PRESS 0x10
+#define PUSHBUTTONS_EV_RELEASE 0x20
+#define PUSHBUTTONS_EV_LONG 0x30
+#define PUSHBUTTONS_EV_REPEAT 0x40
+#define PUSHBUTTONS_EV_TYPE(ev) ((ev) & 0xf0)
+#define PUSHBUTTONS_EV_KEY(ev) ((ev) & 0x0f)
+
+#define PUSHBUTTONS_QUEUE_SIZE 8 // power of 2
+
+// Pin directions, pullups and pin change interrupt
 void PUSHBUTTONS_Init(void);
 
+// Debounce and event generation, call from the timer0 ISR
+void PUSHBUTTONS_Tick(void);
+
+// Non blocking, next event from the queue or 0
+unsigned char PUSHBUTTONS_GetEvent(void);
+
+// Non blocking, key of the next press/repeat event or KEYPAD_NO_PRESSED_KEY
 unsigned char PUSHBUTTONS_Read(void);
 
-#endif
\ No newline at end of file
+#endif
@@ -1,17 +1,13 @@
 #ifndef _RELAY_H
 #define _RELAY_H
 
-#include <DIO.h>
-#include <util/delay.h>
+#include "hal.h"
+#include "DIO.h"
 
-#define HEATER_PRT 'B'
-#define HEATER_PIN 5
-
-#define LAMP_PRT 'B'
-#define LAMP_PIN 4
-
-#define BUZZER_PRT 'C'
-#define BUZZER_PIN 5
+// PINS (port letter, bit)
+#define HEATER_IO B, 5
+#define LAMP_IO B, 4
+#define BUZZER_IO C, 5
 
 // SET PIN DIRECTIONS
 void RELAY_Init(void);
@@ -28,10 +24,6 @@ void RELAY_Heater(unsigned char state);
 */
 void RELAY_Lamp(unsigned char state);
 
-// Failure.. dont use with interrupt timer service
-void RELAY_Lamp_Alert(unsigned char timesec);
-// Initializes buzzer pin
+// Initializes buzzer pin, the alarm annunciator drives it
 void BUZZER_Init(void);
-// Variable ON pulse argument
-void BUZZER_Pulse_ms(unsigned short ms);
 #endif
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#include "STD_TYPES.h"
+
+/* RUN TO COMPLETION SCHEDULER
+SCHED_Tick runs from the timer0 ISR and only releases tasks that are due,
+SCHED_Dispatch runs from the main loop and executes the ready task with
+the highest priority. Periods and phases are in timer0 ticks (16ms).
+*/
+
+typedef struct
+{
+    void (*task)(void); // run to completion function
+    u16 period;         // release period in ticks
+    u16 phase;          // first release delay in ticks, spreads tasks over ticks
+    u8 priority;        // 0 is the highest
+
+    // runtime, owned by the scheduler
+    volatile u16 countdown; // ticks left until the next release
+    volatile u8 ready;      // released and not yet run
+    u16 runs;               // completed runs
+    u16 last_time;          // execution time of the last run in timer1 counts (4us)
+    u16 worst_time;         // worst execution time, 0xffff if longer than a timer1 wrap
+    u16 overruns;           // released again before the previous release ran
+} SCHED_Task_t;
+
+#define SCHED_TASK(fn, period, phase, priority) {fn, period, phase, priority, 0, 0, 0, 0, 0, 0}
+
+void SCHED_Init(SCHED_Task_t *tasks, u8 count);
+void SCHED_Tick(void);       // call from the timer0 ISR
+u8 SCHED_Dispatch(void);     // returns 0 if no task was ready
+u8 SCHED_Pending(void);      // a task SCHED_Dispatch would run, call with interrupts off before sleeping
+void SCHED_Delay_ms(u16 ms); // keeps dispatching while waiting, main loop code only
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef _SENSOR_H
+#define _SENSOR_H
+
+#include "STD_TYPES.h"
+
+/* FIXED POINT SENSOR CONVERSION
+out = ((code * gain) >> shift) + offset, integer only
+or, when a table is given, linear interpolation between SENSOR_TABLE_POINTS
+values spread over the 10 bit ADC range (table lives in flash)
+*/
+
+typedef s16 temp_dC_t; // temperature in 0.1 C steps
+
+#define SENSOR_DC(celsius) ((temp_dC_t)((celsius) * 10)) // whole degrees to temp_dC_t
+
+#define SENSOR_TABLE_STEP_LOG2 5 // one table point each 32 codes
+#define SENSOR_TABLE_POINTS ((1024 >> SENSOR_TABLE_STEP_LOG2) + 1)
+
+// Builds a SENSOR_TABLE_POINTS long initializer from F(code) at compile time
+#define SENSOR_TABLE_4(F, i) F((i) * 32), F(((i) + 1) * 32), F(((i) + 2) * 32), F(((i) + 3) * 32)
+#define SENSOR_TABLE_16(F, i) SENSOR_TABLE_4(F, i), SENSOR_TABLE_4(F, (i) + 4), SENSOR_TABLE_4(F, (i) + 8), SENSOR_TABLE_4(F, (i) + 12)
+#define SENSOR_TABLE(F) {SENSOR_TABLE_16(F, 0), SENSOR_TABLE_16(F, 16), F(1024)}
+
+typedef struct
+{
+    u16 gain;         // multiplier in Q(shift)
+    u8 shift;         // fractional bits of gain
+    s16 offset;       // added after scaling, in output units
+    const s16 *table; // optional PROGMEM table, overrides gain/shift when set
+} SENSOR_Channel_t;
+
+// LM35 on AVCC: 5000mV / 1024 / 10mV per C = 4.8828 C/code, 1250/256 exactly in 0.1 C
+extern const SENSOR_Channel_t SENSOR_BodyTemp;
+extern const SENSOR_Channel_t SENSOR_RoomTemp;
+
+s16 SENSOR_Convert(const SENSOR_Channel_t *ch, u16 code);
+
+/* FILTER BLOCK
+Median of 3 spike rejection followed by an exponential smoother,
+y += (x - y) / 2^shift, state kept with shift fractional bits.
+O(1) per sample, call at a fixed rate (time constant ~2^shift calls).
+*/
+typedef struct
+{
+    s16 window[3]; // last three inputs
+    u8 pos;        // next window slot
+    u8 shift;      // smoothing, 0 = median only
+    u8 primed;     // set after the first sample
+    s32 acc;       // smoother state << shift
+} SENSOR_Filter_t;
+
+#define SENSOR_FILTER_INIT(shift) {{0, 0, 0}, 0, (shift), 0, 0}
+
+s16 SENSOR_Filter(SENSOR_Filter_t *f, s16 x); // feeds one sample, returns the filtered value
+
+/* HYSTERESIS
+Two level decision with a dead band, the state is kept inside the band.
+Above: set over level, cleared under level - band.
+Below: set under level, cleared over level + band.
+*/
+u8 SENSOR_Above(u8 state, s16 value, s16 level, s16 band);
+u8 SENSOR_Below(u8 state, s16 value, s16 level, s16 band);
+
+#endif
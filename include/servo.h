@@ -1,12 +1,36 @@
 #ifndef _SERVO_H
 #define _SERVO_H
 
+#include "hal.h"
 #include "DIO.h"
-#include <avr/io.h>
-#include <util/delay.h>
 
-void SERVO_Init(void);
+// POSTURES
+#define SERVO_POSTURE_SIT 0   // back raised (servo right)
+#define SERVO_POSTURE_SLEEP 1 // laid back (servo left)
+
+// STATUS
+#define SERVO_IDLE 0
+#define SERVO_MOVING 1
+
+// MOTION PROFILE IN TIMER0 TICKS (16ms)
+#define SERVO_MOVE_TICKS 31   // ~500ms per posture change
+#define SERVO_RAMP_SHIFT 1    // speed changes one step each 2 ticks
+#define SERVO_SPEED_MAX 4     // OCR2B offset from the stop value at cruise
+#define SERVO_QUEUE_SIZE 4    // power of 2
+#define SERVO_SETTLE_MS 1000  // supply settle time before the first pulse
+
+void SERVO_Init(void);  // pin only, moves wait for SERVO_Start
+void SERVO_Start(void); // sets up the PWM timer, call SERVO_SETTLE_MS after power up; it is clocked only during moves
+void SERVO_SetPosture(unsigned char posture); // restored posture, no motion
 void SERVO_On(unsigned char cmd);
 void SERVO_Off(void);
 
-#endif
\ No newline at end of file
+// Queues a posture change, returns 0 if the queue is full
+unsigned char SERVO_Move(unsigned char posture);
+// Runs the motion state machine, call from the timer0 ISR
+void SERVO_Tick(void);
+unsigned char SERVO_Status(void);
+unsigned char SERVO_Posture(void); // last posture reached
+unsigned char SERVO_Started(void);
+
+#endif
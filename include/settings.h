@@ -0,0 +1,32 @@
+#ifndef _SETTINGS_H
+#define _SETTINGS_H
+
+#include "STD_TYPES.h"
+#include "eeprom.h"
+
+/* PERSISTED SETTINGS
+Two copies at EEPROM_SETTINGS_START, each with a sequence number and a
+CRC16. A save goes to the older copy, so a reset in the middle of it
+leaves the other one valid. Load returns the newest valid copy.
+*/
+#define SETTINGS_VERSION 2
+#define SETTINGS_SLOT_SIZE 0x20 // bytes per copy
+
+typedef struct
+{
+    u8 version;
+    u8 seq;              // newer copy wins, wraps
+    u8 heater_threshold; // C
+    u8 heater_enable;
+    u8 lamp_enable;
+    u8 lamp_state;
+    u8 mode;             // 0 sitting, 1 sleeping
+    u16 cal_zero;        // load cell calibration, see LOADCELL_Cal_t
+    u16 cal_gain;
+    u16 crc;             // CRC16 of the fields before it
+} SETTINGS_t;
+
+u8 SETTINGS_Load(SETTINGS_t *s); // returns 0 and leaves s alone when no copy is valid
+u8 SETTINGS_Save(SETTINGS_t *s); // queues the write, returns 0 if the EEPROM queue is full
+
+#endif
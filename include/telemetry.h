@@ -0,0 +1,80 @@
+#ifndef _TELEMETRY_H
+#define _TELEMETRY_H
+
+#include "STD_TYPES.h"
+#include "sensor.h"
+#include "lcd.h"
+
+/* BINARY TELEMETRY OVER THE USART
+Records are encoded into the UART ring and sent from its interrupt, a full
+ring drops the record (counted, and visible as a sequence gap) instead of
+waiting. Each frame is COBS coded and ends with a 0x00 byte:
+  type, seq, tick (u16), payload, crc (u16 CRC-16/CCITT over all before it)
+Multi byte fields are little endian, tick is the low half of TIMER0_Ticks
+(16.384ms). tools/tlm_decode.c reads the stream from a tty or pty.
+TXD is PD1, the LCD RW line on the stock board: telemetry is only built in
+once RW is strapped to GND (LCD_RW_TIED), else the calls compile to nothing
+and the USART stays off.
+*/
+
+#define TELEMETRY_EN LCD_RW_TIED
+
+// RECORD TYPES AND PAYLOADS
+#define TLM_REC_SAMPLE 0x01 // body s16, room s16 (0.1 C), weight u16, load cell raw u16, heater duty u16, flags u8
+#define TLM_REC_STATE 0x02  // mode, heater enable, heater setpoint (C), lamp enable, lamp state, alarm bits
+#define TLM_REC_ALARM 0x03  // slot, 1 raised 0 cleared
+#define TLM_REC_STATS 0x04  // records sent u16, records dropped u16, lowest free ring bytes u8
+
+// SAMPLE FLAGS
+#define TLM_FLAG_HEATER 0x01 // heater relay on
+#define TLM_FLAG_LAMP 0x02   // lamp relay on
+#define TLM_FLAG_FEVER 0x04
+#define TLM_FLAG_WEIGHT 0x08
+#define TLM_FLAG_EXIT 0x10 // bed exit alarm
+
+#define TLM_HEADER_SIZE 4
+#define TLM_PAYLOAD_MAX 12
+#define TLM_FRAME_MAX (TLM_HEADER_SIZE + TLM_PAYLOAD_MAX + 2 + 2) // crc, COBS code byte and delimiter
+
+// RATES
+#define TLM_SAMPLE_DIV 1        // default: every sample (100ms)
+#define TLM_STATE_KEEPALIVE 10  // s, state is also sent on each change
+#define TLM_STATS_PERIOD 60     // s
+
+typedef struct
+{
+    temp_dC_t body;
+    temp_dC_t room;
+    u16 weight;
+    u16 raw;  // load cell code
+    u16 duty; // heater PI output in window steps
+    u8 flags; // TLM_FLAG_*
+} TLM_Sample_t;
+
+typedef struct
+{
+    u8 mode;
+    u8 heater_enable;
+    u8 heater_threshold;
+    u8 lamp_enable;
+    u8 lamp_state;
+    u8 alarms; // bit per alarm slot
+} TLM_State_t;
+
+#if TELEMETRY_EN
+extern u8 TLM_SampleDiv; // 0 off, n sends every nth sample
+
+void TLM_Init(void);
+void TLM_Sample(const TLM_Sample_t *s); // each sensing pass, decimated by TLM_SampleDiv
+void TLM_State(const TLM_State_t *s);   // each second, sent if changed or for the keepalive
+void TLM_Alarm(u8 slot, u8 raised);
+void TLM_Second(void);                  // each second, sends the stats record
+#else
+#define TLM_Init()
+#define TLM_Sample(s) ((void)(s))
+#define TLM_State(s) ((void)(s))
+#define TLM_Alarm(slot, raised) ((void)(slot), (void)(raised))
+#define TLM_Second()
+#endif
+
+#endif
@@ -1,10 +1,8 @@
 #ifndef _TIMER_H
 #define _TIMER_H
 
-#include <DIO.h>
-#include <avr/io.h>
-#include <util/delay.h>
-#include <avr/interrupt.h>
+#include "hal.h"
+#include "DIO.h"
 /* TIMER0, INTERRUPT FLAG EACH 16MS
 NORMAL MODE, OVERFLOW INTERRUPT
 --
@@ -13,4 +11,19 @@ ISR(TIMER0_OVF_vect)
 */
 void TIMER0_Init(void);
 
-#endif
\ No newline at end of file
+// Number of timer0 overflows since reset, incremented by the overflow ISR
+extern volatile unsigned long TIMER0_Ticks;
+// Atomic copy of TIMER0_Ticks for main loop code
+unsigned long TIMER0_GetTicks(void);
+// Microseconds since TIMER0_Init, 64us steps, wraps after ~71 minutes
+unsigned long TIMER0_Micros(void);
+
+/* TIMER1, FREE RUNNING TIMEBASE
+NORMAL MODE, PRESCALER 64, ONE COUNT EACH 4US, WRAPS EVERY 262MS
+no interrupts, used for measuring execution times
+*/
+#define TIMER1_US_PER_COUNT 4
+void TIMER1_Init(void);
+unsigned short TIMER1_Now(void);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef _UART_H
+#define _UART_H
+
+#include "STD_TYPES.h"
+
+/* USART0 TRANSMIT RING
+8N1, transmit only (TXD on PD1). Writers copy into the ring and return,
+the data register empty interrupt sends one byte each and turns itself off
+when the ring is empty, nothing ever waits for the line.
+*/
+#define UART_BAUD 115200UL
+#define UART_F_CPU 16000000UL
+#define UART_UBRR ((UART_F_CPU + 4 * UART_BAUD) / (8 * UART_BAUD) - 1) // double speed, 16 -> 117647 baud (+2.1%)
+#define UART_TX_SIZE 128 // power of 2
+
+void UART_Init(void);
+u8 UART_Write(const u8 *data, u8 len); // all or nothing, returns 0 if it does not fit
+u8 UART_Free(void);                    // free bytes in the ring
+u8 UART_Idle(void);                    // ring empty and the last byte is out of the shift register
+
+#endif
@@ -1,7 +1,55 @@
 #include "ADC.h"
 #include "STD_TYPES.h"
-#include "avr/io.h"
+#include "hal.h"
 #include "BIT_MATH.h"
+#include "timer.h"
+#include "profiler.h"
+
+// SCAN ENGINE STATE
+static const u8 *ADC_Channels;             // channel list given to ADC_ScanStart
+static u8 ADC_Count = 0;                   // number of channels in the list
+static u8 ADC_Index = 0;                   // list index of the conversion in progress
+static u8 ADC_Resume = 0;                  // list index to go on with after a visit of the oversampled channel
+static volatile u8 ADC_Discard = 0;        // conversions to throw away after an ADMUX switch
+static volatile u8 ADC_Front = 0;          // buffer index readers use
+static volatile u8 ADC_Seq = 0;            // incremented on each buffer flip
+static volatile u8 ADC_Ready = 0;          // set on the first buffer flip
+static volatile u8 ADC_Due = 0;            // conversion of this tick not started yet
+static ADC_Sample_t ADC_Table[2][ADC_SCAN_MAX]; // double buffered sample table
+
+// OVERSAMPLED CHANNEL STATE
+static u8 ADC_OsIndex = 0xff;              // list index of the oversampled channel, 0xff for none
+static u8 ADC_OsShift;                     // os_log2 - extra_bits
+static u16 ADC_OsCount;                    // conversions per decimator output
+static u16 ADC_OsLeft;                     // conversions until the next output
+static u8 ADC_OsBurst = 0;                 // conversions left in the current burst, 0 when not bursting
+static u32 ADC_OsSum = 0;                  // boxcar accumulator
+static ADC_Sample_t ADC_OsOut = {0, 0};    // last decimator output
+static volatile u8 ADC_OsSeq = 0;          // incremented on each decimator output
+
+static void ADC_SelectChannel(u8 channel)
+{
+	ADMUX &= 0b11100000;
+	ADMUX |= (channel & 0b00011111);
+}
+
+// list index after i, the oversampled channel is visited in between
+static u8 ADC_NextIndex(u8 i)
+{
+	if (++i == ADC_OsIndex)
+	{
+		i++;
+	}
+	return i;
+}
+
+// back buffer complete, publish it
+static void ADC_Publish(void)
+{
+	ADC_Front ^= 1;
+	ADC_Seq++;
+	ADC_Ready = 1;
+}
 
 void ADC_Init(void)
 {
@@ -32,9 +80,7 @@ MUX4...0        (+ Differential Input)      ( – Differential Input)      Gain
 unsigned short int ADC_Read(unsigned char channel)
 {
 	// ADC Channel Selection
-
-	ADMUX &= 0b11100000;
-	ADMUX |= (channel & 0b00011111);
+	ADC_SelectChannel(channel);
 
 	// Start Single Convertion
 	SET_BIT(ADCSRA, 6);
@@ -45,3 +91,231 @@ unsigned short int ADC_Read(unsigned char channel)
 
 	return ADC;
 }
+
+// TIMER0 must be running, it is the trigger source
+void ADC_ScanStart(const u8 *channels, u8 count)
+{
+	if (count == 0 || count > ADC_SCAN_MAX)
+	{
+		return;
+	}
+
+	// stop conversions while the list is swapped
+	CLR_BIT(ADCSRA, 5);
+	CLR_BIT(ADCSRA, 3);
+	ADC_Due = 0;
+
+	ADC_Channels = channels;
+	ADC_Count = count;
+	ADC_Index = 0;
+	ADC_Resume = 0;
+	ADC_Ready = 0;
+	ADC_OsIndex = 0xff;
+	ADC_OsBurst = 0;
+	ADC_SelectChannel(ADC_Channels[0]);
+	ADC_Discard = 1;
+
+	// Auto trigger source for the oversampling bursts: free running (ADTS = 000)
+	ADCSRB &= 0b11111000;
+
+	// Conversion complete interrupt enable, ADC_Tick and PWR_Idle start the conversions
+	SET_BIT(ADCSRA, 3);
+}
+
+void ADC_Tick(void)
+{
+	if (!ADC_Count || ADC_OsBurst)
+	{
+		return;
+	}
+	if (ADC_Due)
+	{
+		// the main loop did not sleep for a whole tick, convert without it
+		ADC_Due = 0;
+		SET_BIT(ADCSRA, 6);
+		return;
+	}
+	ADC_Due = 1;
+}
+
+u8 ADC_TakeDue(void)
+{
+	if (!ADC_Due)
+	{
+		return 0;
+	}
+	ADC_Due = 0;
+	return 1;
+}
+
+void ADC_Convert(void)
+{
+	SET_BIT(ADCSRA, 6);
+}
+
+void ADC_Oversample(u8 channel, u8 os_log2, u8 extra_bits)
+{
+	u8 i, sreg;
+
+	// a decimated output spans whole bursts
+	if (os_log2 > 8 || (1 << os_log2) < ADC_OS_BURST || 2 * extra_bits > os_log2)
+	{
+		return;
+	}
+
+	for (i = 0; i < ADC_Count; i++)
+	{
+		if (ADC_Channels[i] == channel)
+		{
+			sreg = SREG;
+			cli();
+			ADC_OsShift = os_log2 - extra_bits;
+			ADC_OsCount = 1 << os_log2;
+			ADC_OsLeft = ADC_OsCount;
+			ADC_OsSum = 0;
+			ADC_OsIndex = i;
+			ADC_Resume = ADC_NextIndex(0xff); // first other channel
+			SREG = sreg;
+			return;
+		}
+	}
+}
+
+u8 ADC_GetSample(u8 channel, ADC_Sample_t *sample)
+{
+	u8 i, seq;
+
+	for (i = 0; i < ADC_Count; i++)
+	{
+		if (ADC_Channels[i] == channel && i == ADC_OsIndex)
+		{
+			// oversampled channel, newer than the scan: retry if an output came while copying
+			do
+			{
+				seq = ADC_OsSeq;
+				*sample = ADC_OsOut;
+			} while (seq != ADC_OsSeq);
+			return 1;
+		}
+		if (ADC_Channels[i] == channel)
+		{
+			// retry if the buffers flipped while copying
+			do
+			{
+				seq = ADC_Seq;
+				*sample = ADC_Table[ADC_Front][i];
+			} while (seq != ADC_Seq);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+u16 ADC_ReadLatest(u8 channel)
+{
+	ADC_Sample_t sample = {0, 0};
+	ADC_GetSample(channel, &sample);
+	return sample.value;
+}
+
+u8 ADC_ScanSeq(void)
+{
+	return ADC_Seq;
+}
+
+u8 ADC_ScanReady(void)
+{
+	return ADC_Ready;
+}
+
+u8 ADC_OversampleSeq(void)
+{
+	return ADC_OsSeq;
+}
+
+// CONVERSION COMPLETE, ONE PER TIMER0 OVERFLOW (BURSTS APART)
+ISR(ADC_vect)
+{
+	u16 value = ADC;
+	PROF_ENTER();
+
+	// first result after a mux switch is not settled
+	if (ADC_Discard)
+	{
+		ADC_Discard--;
+		PROF_EXIT(PROF_ISR_ADC);
+		return;
+	}
+
+	ADC_Sample_t *slot = &ADC_Table[ADC_Front ^ 1][ADC_Index];
+
+	if (ADC_Index == ADC_OsIndex)
+	{
+		if (ADC_OsBurst == 0)
+		{
+			// first conversion of the visit is not settled, free run (ADTS = 000) for the burst after it
+			ADC_OsBurst = ADC_OS_BURST;
+			SET_BIT(ADCSRA, 5);
+			SET_BIT(ADCSRA, 6);
+			PROF_EXIT(PROF_ISR_ADC);
+			return;
+		}
+
+		// boxcar decimator
+		ADC_OsSum += value;
+		if (--ADC_OsLeft == 0)
+		{
+			ADC_OsOut.value = (u16)(ADC_OsSum >> ADC_OsShift);
+			ADC_OsOut.tick = (u16)TIMER0_Ticks;
+			ADC_OsSum = 0;
+			ADC_OsLeft = ADC_OsCount;
+			ADC_OsSeq++;
+		}
+
+		if (--ADC_OsBurst != 0)
+		{
+			PROF_EXIT(PROF_ISR_ADC);
+			return;
+		}
+
+		// burst done, back to one conversion per tick, the conversion in flight is dropped
+		CLR_BIT(ADCSRA, 5);
+		ADC_Discard = 1;
+		*slot = ADC_OsOut;
+		if (ADC_Count == 1)
+		{
+			ADC_Publish();
+			PROF_EXIT(PROF_ISR_ADC);
+			return;
+		}
+		ADC_Index = ADC_Resume;
+	}
+	else
+	{
+		slot->value = value;
+		slot->tick = (u16)TIMER0_Ticks;
+		ADC_Index = ADC_NextIndex(ADC_Index);
+		if (ADC_Index >= ADC_Count)
+		{
+			ADC_Index = ADC_NextIndex(0xff);
+			ADC_Publish();
+		}
+		if (ADC_OsIndex != 0xff && ADC_Index < ADC_Count)
+		{
+			// the oversampled channel between every two others, it drops its own unsettled conversion
+			ADC_Resume = ADC_Index;
+			ADC_Index = ADC_OsIndex;
+			ADC_SelectChannel(ADC_Channels[ADC_Index]);
+			PROF_EXIT(PROF_ISR_ADC);
+			return;
+		}
+	}
+
+	if (ADC_Count > 1)
+	{
+		// takes effect from the next trigger
+		ADC_SelectChannel(ADC_Channels[ADC_Index]);
+		ADC_Discard++;
+	}
+	PROF_EXIT(PROF_ISR_ADC);
+}
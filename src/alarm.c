@@ -0,0 +1,190 @@
+#include "alarm.h"
+#include "hal.h"
+#include "relay.h"
+
+#define ALARM_PRIORITY_HIGH 0
+#define ALARM_PRIORITY_MEDIUM 1
+
+// IEC 60601-1-8 style bursts, 16ms ticks
+// high: 10 pulses as 3+2, 3+2 repeated every ~5.8s
+static const u8 ALARM_HighBuzzer[] PROGMEM = {
+    ALARM_ON(6), ALARM_OFF(5), ALARM_ON(6), ALARM_OFF(5), ALARM_ON(6), ALARM_OFF(20),
+    ALARM_ON(6), ALARM_OFF(5), ALARM_ON(6), ALARM_OFF(60),
+    ALARM_ON(6), ALARM_OFF(5), ALARM_ON(6), ALARM_OFF(5), ALARM_ON(6), ALARM_OFF(20),
+    ALARM_ON(6), ALARM_OFF(5), ALARM_ON(6),
+    ALARM_OFF(127), ALARM_OFF(127), ALARM_OFF(60), 0};
+// medium: 3 pulses repeated every ~8s
+static const u8 ALARM_MediumBuzzer[] PROGMEM = {
+    ALARM_ON(10), ALARM_OFF(8), ALARM_ON(10), ALARM_OFF(8), ALARM_ON(10),
+    ALARM_OFF(127), ALARM_OFF(127), ALARM_OFF(127), ALARM_OFF(64), 0};
+// lamp flashes ~2Hz for high, ~1Hz for medium
+static const u8 ALARM_HighLamp[] PROGMEM = {ALARM_ON(16), ALARM_OFF(16), 0};
+static const u8 ALARM_MediumLamp[] PROGMEM = {ALARM_ON(31), ALARM_OFF(31), 0};
+
+static const u8 *const ALARM_Buzzer[] = {ALARM_HighBuzzer, ALARM_MediumBuzzer};
+static const u8 *const ALARM_Lamp[] = {ALARM_HighLamp, ALARM_MediumLamp};
+
+static const u8 ALARM_Priority[ALARM_SLOTS] = {ALARM_PRIORITY_HIGH, ALARM_PRIORITY_HIGH, ALARM_PRIORITY_MEDIUM};
+static const char ALARM_Text[ALARM_SLOTS][12] PROGMEM = {"MAX WEIGHT!", "BED EXIT!", "HIGH FEVER!"};
+
+// SLOT STATE
+static volatile u8 ALARM_State[ALARM_SLOTS];
+static volatile u16 ALARM_Snooze_Ticks[ALARM_SLOTS];
+
+// SEQUENCER STATE (ISR only)
+typedef struct
+{
+    const u8 *pattern;
+    u8 index;
+    u8 left; // ticks left in the current step
+} ALARM_Player_t;
+
+static ALARM_Player_t ALARM_BuzzerPlayer, ALARM_LampPlayer;
+static u8 ALARM_Playing = 0xff; // slot being annunciated, 0xff none
+
+void ALARM_Init(void)
+{
+    for (u8 i = 0; i < ALARM_SLOTS; i++)
+    {
+        ALARM_State[i] = ALARM_INACTIVE;
+    }
+    ALARM_Playing = 0xff;
+}
+
+void ALARM_Set(u8 slot, u8 condition)
+{
+    if (condition)
+    {
+        if (ALARM_State[slot] == ALARM_INACTIVE)
+        {
+            ALARM_State[slot] = ALARM_ACTIVE;
+        }
+    }
+    else
+    {
+        ALARM_State[slot] = ALARM_INACTIVE;
+    }
+}
+
+void ALARM_Snooze(void)
+{
+    u8 sreg = SREG;
+    cli();
+    for (u8 i = 0; i < ALARM_SLOTS; i++)
+    {
+        if (ALARM_State[i] == ALARM_ACTIVE)
+        {
+            ALARM_State[i] = ALARM_SNOOZED;
+            ALARM_Snooze_Ticks[i] = ALARM_SNOOZE_TICKS;
+        }
+    }
+    SREG = sreg;
+}
+
+void ALARM_Acknowledge(void)
+{
+    for (u8 i = 0; i < ALARM_SLOTS; i++)
+    {
+        if (ALARM_State[i] == ALARM_ACTIVE || ALARM_State[i] == ALARM_SNOOZED)
+        {
+            ALARM_State[i] = ALARM_ACKED;
+        }
+    }
+}
+
+u8 ALARM_Sounding(void)
+{
+    return ALARM_Playing != 0xff;
+}
+
+u8 ALARM_Active(void)
+{
+    for (u8 i = 0; i < ALARM_SLOTS; i++)
+    {
+        if (ALARM_State[i] != ALARM_INACTIVE)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char *ALARM_Message(void)
+{
+    for (u8 i = 0; i < ALARM_SLOTS; i++)
+    {
+        if (ALARM_State[i] != ALARM_INACTIVE)
+        {
+            return ALARM_Text[i];
+        }
+    }
+    return 0;
+}
+
+static void ALARM_Start(ALARM_Player_t *p, const u8 *pattern)
+{
+    p->pattern = pattern;
+    p->index = 0;
+    p->left = 0;
+}
+
+// returns the output level for this tick
+static u8 ALARM_Step(ALARM_Player_t *p)
+{
+    u8 step = pgm_read_byte(&p->pattern[p->index]);
+
+    if (p->left == 0)
+    {
+        if (step == 0)
+        {
+            p->index = 0;
+            step = pgm_read_byte(&p->pattern[0]);
+        }
+        p->left = step & 0x7f;
+    }
+    p->left--;
+    if (p->left == 0)
+    {
+        p->index++;
+    }
+    return step >> 7;
+}
+
+// ISR CONTEXT
+void ALARM_Tick(void)
+{
+    u8 slot = 0xff;
+
+    for (u8 i = 0; i < ALARM_SLOTS; i++)
+    {
+        if (ALARM_State[i] == ALARM_SNOOZED && --ALARM_Snooze_Ticks[i] == 0)
+        {
+            ALARM_State[i] = ALARM_ACTIVE; // snooze over, sound again
+        }
+        if (slot == 0xff && ALARM_State[i] == ALARM_ACTIVE)
+        {
+            slot = i;
+        }
+    }
+
+    if (slot != ALARM_Playing)
+    {
+        if (slot == 0xff)
+        {
+            // silence, the control task puts the lamp back
+            DIO_PIN_LOW(BUZZER_IO);
+            ALARM_Playing = slot;
+            return;
+        }
+        ALARM_Start(&ALARM_BuzzerPlayer, ALARM_Buzzer[ALARM_Priority[slot]]);
+        ALARM_Start(&ALARM_LampPlayer, ALARM_Lamp[ALARM_Priority[slot]]);
+        ALARM_Playing = slot;
+    }
+    if (slot == 0xff)
+    {
+        return;
+    }
+
+    DIO_PIN_WRITE(BUZZER_IO, ALARM_Step(&ALARM_BuzzerPlayer));
+    DIO_PIN_WRITE(LAMP_IO, ALARM_Step(&ALARM_LampPlayer));
+}
@@ -0,0 +1,140 @@
+#include "bed.h"
+#include "alarm.h"
+#include "hal.h"
+
+void BED_Init(BED_t *b)
+{
+    const SENSOR_Filter_t filter = SENSOR_FILTER_INIT(4);
+
+    b->weight = 60;
+    b->alarm_weight = 0;
+    b->occupancy = 0;
+    BEDEXIT_Init(&b->exit, BED_EXIT_SENSITIVITY);
+    b->alarm_exit = 0;
+    b->body = SENSOR_DC(37);
+    b->room = SENSOR_DC(24);
+    b->alarm_fever = 0;
+    b->body_filter = filter;
+    b->room_filter = filter;
+    b->heater_threshold = 10;
+    b->heater_enable = 1;
+    b->heater_state = 0;
+    HEATER_Init(&b->heater);
+    b->lamp_enable = 1;
+    b->lamp_state = 1;
+    b->mode_old = BED_MODE_SIT;
+    b->mode_new = BED_MODE_SIT;
+    b->alarms = 0;
+}
+
+u8 BED_Weigh(BED_t *b, u16 weight)
+{
+    u8 event = BEDEXIT_Step(&b->exit, weight);
+
+    // only a sleeping patient getting up is a fall risk, back in bed clears it
+    if (event == BEDEXIT_EV_EXIT && b->mode_new == BED_MODE_SLEEP)
+    {
+        b->alarm_exit = 1;
+    }
+    else if (event == BEDEXIT_EV_ENTRY)
+    {
+        b->alarm_exit = 0;
+    }
+    return event;
+}
+
+u8 BED_Sense(BED_t *b, u16 weight, temp_dC_t body, temp_dC_t room)
+{
+    u8 alarms;
+
+    // ------------WEIGHT------------------//
+    b->weight = weight;
+    b->alarm_weight = weight > BED_MAX_WEIGHT;
+    if (b->exit.occupied) // decided by BED_Weigh
+    {
+        b->occupancy++;
+    }
+    else
+    {
+        b->occupancy = 0; // if not used
+    }
+    if (b->mode_new != BED_MODE_SLEEP)
+    {
+        b->alarm_exit = 0; // sitting up, getting out is expected
+    }
+
+    //-------------TEMPERATURE-----------//
+    // filtered before any decision
+    b->body = SENSOR_Filter(&b->body_filter, body);
+    b->room = SENSOR_Filter(&b->room_filter, room);
+    b->alarm_fever = SENSOR_Above(b->alarm_fever, b->body, BED_FEVER_TEMP, BED_FEVER_BAND);
+
+    //-------------ALARMS----------------//
+    alarms = (b->alarm_weight << ALARM_SLOT_WEIGHT) | (b->alarm_exit << ALARM_SLOT_EXIT) |
+             (b->alarm_fever << ALARM_SLOT_FEVER);
+    alarms ^= b->alarms;
+    b->alarms ^= alarms;
+    return alarms;
+}
+
+u8 BED_Heater(BED_t *b)
+{
+    b->heater_state = HEATER_Run(&b->heater, b->room, SENSOR_DC(b->heater_threshold), b->heater_enable);
+    return b->heater_state;
+}
+
+u8 BED_Control(BED_t *b)
+{
+    if (b->mode_old == b->mode_new)
+    {
+        return BED_MOVE_NONE;
+    }
+    b->mode_old = b->mode_new;
+
+    // sleeping: laid back and light off, sitting: up front and light on
+    if (b->mode_new == BED_MODE_SLEEP)
+    {
+        b->lamp_state = 0;
+        return BED_MOVE_SLEEP;
+    }
+    b->lamp_state = 1;
+    return BED_MOVE_SIT;
+}
+
+u8 BED_Lamp(const BED_t *b)
+{
+    return b->lamp_state && b->lamp_enable;
+}
+
+void BED_Publish(const BED_t *b, BED_Shared_t *s)
+{
+    s->seq++;
+    HAL_Barrier();
+    s->view.weight = b->weight;
+    s->view.occupancy = b->occupancy;
+    s->view.body = b->body;
+    s->view.room = b->room;
+    s->view.heater_duty = HEATER_Duty(&b->heater);
+    s->view.heater_threshold = b->heater_threshold;
+    s->view.heater_enable = b->heater_enable;
+    s->view.heater_state = b->heater_state;
+    s->view.lamp_enable = b->lamp_enable;
+    s->view.lamp_state = b->lamp_state;
+    s->view.mode = b->mode_new;
+    s->view.alarms = b->alarms;
+    HAL_Barrier();
+    s->seq++;
+}
+
+void BED_Snapshot(const BED_Shared_t *s, BED_View_t *v)
+{
+    u8 seq;
+
+    do
+    {
+        seq = s->seq;
+        HAL_Barrier();
+        *v = s->view;
+        HAL_Barrier();
+    } while ((seq & 1) || seq != s->seq);
+}
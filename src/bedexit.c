@@ -0,0 +1,76 @@
+#include "bedexit.h"
+
+// exit limits per sensitivity level, 64ths of the patient weight * samples
+static const u8 BEDEXIT_Limit[BEDEXIT_LEVELS] = {8, 2, 1};
+
+void BEDEXIT_Init(BEDEXIT_t *d, u8 sensitivity)
+{
+    d->occupied = 0;
+    d->settle = 0;
+    d->sum = 0;
+    d->ref = 0;
+    BEDEXIT_SetSensitivity(d, sensitivity);
+}
+
+void BEDEXIT_SetSensitivity(BEDEXIT_t *d, u8 sensitivity)
+{
+    d->limit = BEDEXIT_Limit[sensitivity < BEDEXIT_LEVELS ? sensitivity : BEDEXIT_MEDIUM];
+}
+
+u8 BEDEXIT_Step(BEDEXIT_t *d, u16 weight)
+{
+    s16 w = weight > BEDEXIT_MAX_KG ? BEDEXIT_MAX_KG : (s16)weight;
+    s16 half = (s16)(d->ref >> 17);
+    s32 step;
+
+    if (!d->occupied)
+    {
+        if (d->settle)
+        {
+            // still getting up
+            d->settle = w <= BEDEXIT_ENTRY_KG ? 0 : d->settle - 1;
+            return BEDEXIT_EV_NONE;
+        }
+        d->sum += w - BEDEXIT_ENTRY_KG;
+        if (d->sum < 0)
+        {
+            d->sum = 0;
+        }
+        if (d->sum <= BEDEXIT_ENTRY_SUM)
+        {
+            return BEDEXIT_EV_NONE;
+        }
+        // the weight is still rising, the reference catches up while settling
+        d->occupied = 1;
+        d->settle = BEDEXIT_SETTLE;
+        d->sum = 0;
+        d->ref = (u32)w << 16;
+        return BEDEXIT_EV_ENTRY;
+    }
+
+    d->sum += half - w;
+    if (d->sum > 0)
+    {
+        // reference held while the test runs, limit scaled to the patient (2 * half / 64)
+        if (d->sum <= (s16)(((u16)d->limit * (u16)half) >> 5))
+        {
+            return BEDEXIT_EV_NONE;
+        }
+        d->occupied = 0;
+        d->settle = BEDEXIT_SETTLE;
+        d->sum = 0;
+        return BEDEXIT_EV_EXIT;
+    }
+    d->sum = 0;
+    step = ((s32)w << 16) - (s32)d->ref;
+    if (d->settle)
+    {
+        d->settle--;
+        d->ref += step >> BEDEXIT_REF_FAST;
+    }
+    else
+    {
+        d->ref += step >> BEDEXIT_REF_SLOW;
+    }
+    return BEDEXIT_EV_NONE;
+}
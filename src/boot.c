@@ -0,0 +1,86 @@
+#include "boot.h"
+#include "hal.h"
+#include "timer.h"
+#include "lcd.h"
+
+u8 BOOT_ResetFlags = 0;
+
+static BOOT_Step_t *BOOT_Steps;
+static u8 BOOT_Count = 0;
+static u8 BOOT_Left = 0;
+static u16 BOOT_ControlMs; // control loop running
+static u16 BOOT_UiMs;      // first usable screen
+
+u16 BOOT_Ms(void)
+{
+    unsigned long us = TIMER0_Micros();
+    return us >= 65535000UL ? 65535 : (u16)(us / 1000);
+}
+
+void BOOT_Init(BOOT_Step_t *steps, u8 count)
+{
+    BOOT_Steps = steps;
+    BOOT_Count = count;
+    BOOT_Left = count;
+    BOOT_ControlMs = BOOT_Ms();
+}
+
+void BOOT_Run(void)
+{
+    u8 i;
+
+    if (!BOOT_Left)
+    {
+        return;
+    }
+    for (i = 0; i < BOOT_Count; i++)
+    {
+        if (!BOOT_Steps[i].done_ms && BOOT_Steps[i].step())
+        {
+            BOOT_Steps[i].done_ms = BOOT_Ms() | 1; // 0 means running
+            BOOT_Left--;
+        }
+    }
+}
+
+u8 BOOT_StepDone(u8 index)
+{
+    return index < BOOT_Count && BOOT_Steps[index].done_ms != 0;
+}
+
+u8 BOOT_Done(void)
+{
+    return BOOT_Left == 0;
+}
+
+void BOOT_UiReady(void)
+{
+    if (!BOOT_UiMs)
+    {
+        BOOT_UiMs = BOOT_Ms();
+    }
+}
+
+// name in flash
+static void BOOT_SendMs(const char *name, u16 ms)
+{
+    lcd_sendstring_P(name);
+    lcd_sendchar(':');
+    lcd_send_number(ms);
+    lcd_sendchar(' ');
+}
+
+// row 0: control loop and ui, row 1: steps, all in ms since reset
+void BOOT_ShowPage(void)
+{
+    u8 i;
+
+    lcd_clear();
+    BOOT_SendMs(PSTR("ctl"), BOOT_ControlMs);
+    BOOT_SendMs(PSTR("ui"), BOOT_UiMs);
+    lcd_setcursor(1, 0);
+    for (i = 0; i < BOOT_Count; i++)
+    {
+        BOOT_SendMs(BOOT_Steps[i].name, BOOT_Steps[i].done_ms);
+    }
+}
@@ -0,0 +1,22 @@
+#include "crc.h"
+
+u16 CRC16_Update(u16 crc, u8 data)
+{
+    crc = (crc >> 8) | (crc << 8);
+    crc ^= data;
+    crc ^= (crc & 0xff) >> 4;
+    crc ^= crc << 12;
+    crc ^= (crc & 0xff) << 5;
+    return crc;
+}
+
+u16 CRC16_Block(u16 crc, const void *data, u8 len)
+{
+    const u8 *p = (const u8 *)data;
+
+    while (len--)
+    {
+        crc = CRC16_Update(crc, *p++);
+    }
+    return crc;
+}
@@ -6,7 +6,7 @@
 
 #include "DIO.h"
 
-#include "avr/io.h"
+#include "hal.h"
 
 void DIO_SetPinDirection(char PortName, unsigned char PinNum,
                       unsigned char Direction) {
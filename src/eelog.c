@@ -0,0 +1,315 @@
+#include "eelog.h"
+
+#define EELOG_HDR 0xa0 // page header, bit 0 is the lap
+#define EELOG_END 0xff // end of the records of a page
+#define EELOG_TAG_TREND 0x10
+#define EELOG_TAG_DELTA 0x20
+#define EELOG_TAG_EVENT 0x30
+#define EELOG_RECORD_MAX 16 // longest record, absolute trend
+#define EELOG_QUEUE_NEED (EELOG_RECORD_MAX + 3) // page start, record and terminator
+
+#define EELOG_ADDR(page, offset) (EEPROM_LOG_START + (u16)(page) * EELOG_PAGE_SIZE + (offset))
+
+// WRITER STATE
+static u8 EELOG_Page;     // page being filled
+static u8 EELOG_Offset;   // next free byte in the page, EELOG_PAGE_SIZE when full
+static u8 EELOG_Lap;      // lap bit of EELOG_Page
+static u8 EELOG_Absolute; // next trend must be absolute
+static u16 EELOG_Minute;   // minutes since boot
+static EELOG_Trend_t EELOG_Last;
+
+// page header, 0xff if never written
+static u8 EELOG_Header(u8 page)
+{
+    return EEPROM_Read(EELOG_ADDR(page, 0));
+}
+
+static u8 EELOG_Valid(u8 hdr)
+{
+    return (hdr & 0xfe) == EELOG_HDR;
+}
+
+/* VARINTS, 7 bits per byte low first, bit 7 set on all but the last byte.
+Signed values are zigzag coded so small negatives stay short.
+*/
+static u8 EELOG_PutVarint(u8 *p, u16 v)
+{
+    u8 n = 0;
+    while (v >= 0x80)
+    {
+        p[n++] = (u8)v | 0x80;
+        v >>= 7;
+    }
+    p[n++] = (u8)v;
+    return n;
+}
+
+static u16 EELOG_Zigzag(s16 v)
+{
+    return ((u16)v << 1) ^ (u16)(v >> 15);
+}
+
+static s16 EELOG_Unzigzag(u16 v)
+{
+    return (s16)(v >> 1) ^ -(s16)(v & 1);
+}
+
+// reads one varint, returns 0 on the end of the page
+static u8 EELOG_GetVarint(EELOG_Cursor_t *c, u16 *v)
+{
+    u8 b, shift = 0;
+
+    *v = 0;
+    do
+    {
+        if (c->offset >= EELOG_PAGE_SIZE)
+        {
+            return 0;
+        }
+        b = EEPROM_Read(EELOG_ADDR(c->page, c->offset++));
+        *v |= (u16)(b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return 1;
+}
+
+void EELOG_Init(void)
+{
+    u8 first = EELOG_Header(0);
+    u8 lo = 0, hi = EELOG_PAGES - 1, mid;
+
+    EELOG_Absolute = 1;
+    EELOG_Minute = 0;
+
+    if (!EELOG_Valid(first))
+    {
+        // empty log, page 0 is started by the first record
+        EELOG_Page = EELOG_PAGES - 1;
+        EELOG_Offset = EELOG_PAGE_SIZE;
+        EELOG_Lap = 1;
+        return;
+    }
+
+    // pages 0..head carry the lap of page 0, later pages an older lap or nothing
+    while (lo < hi)
+    {
+        mid = (lo + hi + 1) >> 1;
+        if (EELOG_Header(mid) == first)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    EELOG_Page = lo;
+    EELOG_Lap = first & 1;
+
+    // append after the last record of the head page
+    EELOG_Cursor_t c = {EELOG_Page, 1, 1, {0, 0, 0, 0}, 0};
+    EELOG_Record_t r;
+    EELOG_Offset = 1;
+    while (EELOG_Next(&c, &r))
+    {
+        EELOG_Offset = c.offset;
+    }
+}
+
+// queues a record that fits the page, terminator first, tag last
+static void EELOG_Append(const u8 *rec, u8 len)
+{
+    u8 i, end = EELOG_Offset + len;
+
+    if (end < EELOG_PAGE_SIZE)
+    {
+        EEPROM_Write(EELOG_ADDR(EELOG_Page, end), EELOG_END);
+    }
+    for (i = len; i-- > 0;)
+    {
+        EEPROM_Write(EELOG_ADDR(EELOG_Page, EELOG_Offset + i), rec[i]);
+    }
+    EELOG_Offset = end;
+}
+
+static void EELOG_NewPage(void)
+{
+    u8 page = EELOG_Page + 1;
+
+    if (page == EELOG_PAGES)
+    {
+        page = 0;
+        EELOG_Lap ^= 1;
+    }
+    // old records are cut off before the header marks the page as new
+    EEPROM_Write(EELOG_ADDR(page, 1), EELOG_END);
+    EEPROM_Write(EELOG_ADDR(page, 0), EELOG_HDR | EELOG_Lap);
+    EELOG_Page = page;
+    EELOG_Offset = 1;
+    EELOG_Absolute = 1;
+}
+
+static u8 EELOG_EncodeTrend(u8 *rec, const EELOG_Trend_t *t)
+{
+    u8 n = 1;
+
+    if (EELOG_Absolute)
+    {
+        rec[0] = EELOG_TAG_TREND;
+        n += EELOG_PutVarint(&rec[n], EELOG_Minute);
+        n += EELOG_PutVarint(&rec[n], EELOG_Zigzag(t->body));
+        n += EELOG_PutVarint(&rec[n], EELOG_Zigzag(t->room));
+        n += EELOG_PutVarint(&rec[n], t->weight);
+        n += EELOG_PutVarint(&rec[n], t->occupancy);
+        return n;
+    }
+
+    rec[0] = EELOG_TAG_DELTA;
+    if (t->body != EELOG_Last.body)
+    {
+        rec[0] |= 1;
+        n += EELOG_PutVarint(&rec[n], EELOG_Zigzag(t->body - EELOG_Last.body));
+    }
+    if (t->room != EELOG_Last.room)
+    {
+        rec[0] |= 2;
+        n += EELOG_PutVarint(&rec[n], EELOG_Zigzag(t->room - EELOG_Last.room));
+    }
+    if (t->weight != EELOG_Last.weight)
+    {
+        rec[0] |= 4;
+        n += EELOG_PutVarint(&rec[n], EELOG_Zigzag(t->weight - EELOG_Last.weight));
+    }
+    if (t->occupancy != EELOG_Last.occupancy)
+    {
+        rec[0] |= 8;
+        n += EELOG_PutVarint(&rec[n], EELOG_Zigzag(t->occupancy - EELOG_Last.occupancy));
+    }
+    return n;
+}
+
+u8 EELOG_Trend(const EELOG_Trend_t *trend)
+{
+    u8 rec[EELOG_RECORD_MAX], len, ok = 0;
+
+    if (EEPROM_Free() >= EELOG_QUEUE_NEED)
+    {
+        len = EELOG_EncodeTrend(rec, trend);
+        if (EELOG_Offset + len > EELOG_PAGE_SIZE)
+        {
+            EELOG_NewPage();
+            len = EELOG_EncodeTrend(rec, trend);
+        }
+        EELOG_Append(rec, len);
+        EELOG_Last = *trend;
+        EELOG_Absolute = 0;
+        ok = 1;
+    }
+    else
+    {
+        // dropped, the next delta would skip a minute
+        EELOG_Absolute = 1;
+    }
+    EELOG_Minute++;
+    return ok;
+}
+
+u8 EELOG_Event(u8 event, u8 value)
+{
+    u8 rec[5], len;
+
+    if (EEPROM_Free() < EELOG_QUEUE_NEED)
+    {
+        return 0;
+    }
+    rec[0] = EELOG_TAG_EVENT | (event & 0x0f);
+    rec[1] = value;
+    len = 2 + EELOG_PutVarint(&rec[2], EELOG_Minute);
+    if (EELOG_Offset + len > EELOG_PAGE_SIZE)
+    {
+        EELOG_NewPage();
+    }
+    EELOG_Append(rec, len);
+    return 1;
+}
+
+void EELOG_Rewind(EELOG_Cursor_t *c)
+{
+    u8 next = EELOG_Page + 1 == EELOG_PAGES ? 0 : EELOG_Page + 1;
+
+    // oldest page: after the head when the log has wrapped, else page 0
+    if (EELOG_Valid(EELOG_Header(next)) && EELOG_Header(next) != (EELOG_HDR | EELOG_Lap))
+    {
+        c->page = next;
+        c->pages_left = EELOG_PAGES;
+    }
+    else
+    {
+        c->page = 0;
+        c->pages_left = EELOG_Valid(EELOG_Header(0)) ? EELOG_Page + 1 : 0;
+    }
+    c->offset = 1;
+}
+
+u8 EELOG_Next(EELOG_Cursor_t *c, EELOG_Record_t *r)
+{
+    u8 tag, i;
+    u16 v;
+
+    while (c->pages_left)
+    {
+        tag = c->offset < EELOG_PAGE_SIZE ? EEPROM_Read(EELOG_ADDR(c->page, c->offset)) : EELOG_END;
+        if (tag == EELOG_END)
+        {
+            c->pages_left--;
+            c->page = c->page + 1 == EELOG_PAGES ? 0 : c->page + 1;
+            c->offset = 1;
+            continue;
+        }
+        c->offset++;
+
+        switch (tag & 0xf0)
+        {
+        case EELOG_TAG_TREND:
+            r->type = EELOG_REC_TREND;
+            EELOG_GetVarint(c, &c->minute);
+            EELOG_GetVarint(c, &v);
+            c->last.body = EELOG_Unzigzag(v);
+            EELOG_GetVarint(c, &v);
+            c->last.room = EELOG_Unzigzag(v);
+            EELOG_GetVarint(c, &c->last.weight);
+            EELOG_GetVarint(c, &c->last.occupancy);
+            break;
+
+        case EELOG_TAG_DELTA:
+            r->type = EELOG_REC_TREND;
+            c->minute++;
+            for (i = 0; i < 4; i++)
+            {
+                if (tag & (1 << i))
+                {
+                    EELOG_GetVarint(c, &v);
+                    ((s16 *)&c->last)[i] += EELOG_Unzigzag(v);
+                }
+            }
+            break;
+
+        case EELOG_TAG_EVENT:
+            r->type = EELOG_REC_EVENT;
+            r->event = tag & 0x0f;
+            r->value = EEPROM_Read(EELOG_ADDR(c->page, c->offset++));
+            EELOG_GetVarint(c, &v);
+            r->minute = v;
+            return 1;
+
+        default:
+            // not a record, skip the rest of the page
+            c->offset = EELOG_PAGE_SIZE;
+            continue;
+        }
+        r->minute = c->minute;
+        r->trend = c->last;
+        return 1;
+    }
+    return 0;
+}
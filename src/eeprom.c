@@ -0,0 +1,126 @@
+#include "eeprom.h"
+#include "hal.h"
+#include "BIT_MATH.h"
+
+typedef struct
+{
+    u16 addr;
+    u8 data;
+} EEPROM_Entry_t;
+
+// WRITE QUEUE, single producer (main) single consumer (EE_READY ISR)
+static EEPROM_Entry_t EEPROM_Queue[EEPROM_QUEUE_SIZE];
+static volatile u8 EEPROM_Head = 0; // written by the producer only
+static volatile u8 EEPROM_Tail = 0; // written by the consumer only
+
+void EEPROM_Init(void)
+{
+    EEPROM_Head = 0;
+    EEPROM_Tail = 0;
+    CLR_BIT(EECR, 3); // EERIE
+}
+
+u8 EEPROM_Read(u16 addr)
+{
+    u8 i, sreg, data;
+
+    sreg = SREG;
+    cli();
+
+    // newest queued value wins
+    for (i = EEPROM_Head; i != EEPROM_Tail;)
+    {
+        i = (i - 1) & (EEPROM_QUEUE_SIZE - 1);
+        if (EEPROM_Queue[i].addr == addr)
+        {
+            data = EEPROM_Queue[i].data;
+            SREG = sreg;
+            return data;
+        }
+    }
+
+    // wait for a write in progress, interrupts as the caller had them meanwhile
+    while (EECR & (1 << 1)) // EEPE
+    {
+        SREG = sreg;
+        _delay_us(1);
+        cli();
+    }
+
+    EEAR = addr;
+    SET_BIT(EECR, 0); // EERE
+    data = EEDR;
+    SREG = sreg;
+    return data;
+}
+
+void EEPROM_ReadBlock(u16 addr, u8 *dst, u8 len)
+{
+    while (len--)
+    {
+        *dst++ = EEPROM_Read(addr++);
+    }
+}
+
+u8 EEPROM_Free(void)
+{
+    return (EEPROM_Tail - EEPROM_Head - 1) & (EEPROM_QUEUE_SIZE - 1);
+}
+
+u8 EEPROM_Busy(void)
+{
+    return EEPROM_Head != EEPROM_Tail || (EECR & (1 << 1));
+}
+
+u8 EEPROM_Write(u16 addr, u8 data)
+{
+    u8 next = (EEPROM_Head + 1) & (EEPROM_QUEUE_SIZE - 1);
+
+    if (next == EEPROM_Tail || addr >= EEPROM_SIZE)
+    {
+        return 0;
+    }
+    EEPROM_Queue[EEPROM_Head].addr = addr;
+    EEPROM_Queue[EEPROM_Head].data = data;
+    EEPROM_Head = next;
+
+    // ready interrupt fires right away when idle
+    SET_BIT(EECR, 3); // EERIE
+    return 1;
+}
+
+u8 EEPROM_WriteBlock(u16 addr, const u8 *src, u8 len)
+{
+    if (EEPROM_Free() < len)
+    {
+        return 0;
+    }
+    while (len--)
+    {
+        EEPROM_Write(addr++, *src++);
+    }
+    return 1;
+}
+
+// EEPROM READY, STARTS THE NEXT QUEUED BYTE THAT CHANGES
+ISR(EE_READY_vect)
+{
+    while (EEPROM_Tail != EEPROM_Head)
+    {
+        EEPROM_Entry_t *e = &EEPROM_Queue[EEPROM_Tail];
+
+        EEAR = e->addr;
+        SET_BIT(EECR, 0); // EERE
+        if (EEDR != e->data)
+        {
+            EEDR = e->data;
+            // erase and write, EEPE within 4 cycles of EEMPE
+            SET_BIT(EECR, 2); // EEMPE
+            SET_BIT(EECR, 1); // EEPE
+            EEPROM_Tail = (EEPROM_Tail + 1) & (EEPROM_QUEUE_SIZE - 1);
+            return;
+        }
+        EEPROM_Tail = (EEPROM_Tail + 1) & (EEPROM_QUEUE_SIZE - 1);
+    }
+    CLR_BIT(EECR, 3); // EERIE, queue empty
+}
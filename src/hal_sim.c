@@ -0,0 +1,766 @@
+/* SIMULATED REGISTERS AND VIRTUAL TIME FOR THE NATIVE BUILD
+Only compiled with HAL_NATIVE (platformio env:native). The firmware main()
+runs unchanged, the simulator drives the buttons from a key script, feeds
+the ADC channels and stops after HAL_SIM_SECONDS of virtual time with a
+throughput report.
+The room temperature channel comes from a thermal plant heated by the
+heater relay. HAL_SIM_KEYS replaces the looped key script with keys played
+once after login (211221: heater on at 22 C), HAL_SIM_AMBIENT sets the
+outside temperature. HAL_SIM_EEPROM names a file the EEPROM is loaded from
+and saved to, so runs can follow each other like resets, HAL_SIM_MCUSR sets
+the reset flags (4 brownout, 8 watchdog). HAL_SIM_UART names a file or pty
+that gets the bytes sent on the USART.
+*/
+#ifdef HAL_NATIVE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hal.h"
+
+#define SIM_SECONDS_DEFAULT 3600 // virtual run time, override with the HAL_SIM_SECONDS variable
+#define SIM_KEY_PERIOD_US 3000000UL
+#define SIM_KEY_HOLD_US 100000UL
+#define SIM_DEBOUNCE_US 50000UL // press is in the queue after this (quiet tick + accept tick)
+#define SIM_ADC_CONV_US 104     // 13 ADC clocks at F_CPU / 128
+#define SIM_EE_WRITE_US 3400    // erase and write of one EEPROM byte
+#define SIM_EE_SIZE 1024
+
+// THERMAL PLANT, first order room with a lagging sensor
+#define SIM_AMBIENT_DEFAULT 18.0 // C
+#define SIM_ROOM_TAU_S 600.0     // room time constant
+#define SIM_HEATER_RISE 12.0     // steady state rise over ambient at full power
+#define SIM_SENSOR_TAU_S 20.0    // sensor lag
+#define SIM_HEATER_BIT 5         // heater relay on PB5
+#define SIM_SETTLE_BAND 0.3      // C around the final value
+
+// login, password 1111, then sleep pages and home, sit pages heater off lamp on, forever
+static const char SIM_KeyScript[] = "11111";
+static const char *SIM_KeyLoop = "111122121";
+static uint8_t SIM_KeyOnce = 0;       // stop after one pass of SIM_KeyLoop
+
+// REGISTERS
+volatile uint8_t DDRB, DDRC, DDRD;
+volatile uint8_t PORTB, PORTC, PORTD;
+volatile uint8_t PINB = 0xff, PINC, PIND;
+volatile uint8_t ADCSRB, ADMUX, DIDR0;
+volatile uint16_t ADC;
+volatile uint8_t TCCR0A, TCCR0B, TIMSK0, TIFR0;
+volatile uint8_t TCCR1A, TCCR1B, TIMSK1, TIFR1;
+volatile uint16_t OCR1A, OCR1B;
+volatile uint8_t TCCR2A, TCCR2B, OCR2A, OCR2B;
+volatile uint8_t PCICR, PCMSK0;
+volatile uint8_t SREG, WDTCSR, MCUSR = 0x01; // power on reset, HAL_SIM_MCUSR overrides
+volatile uint16_t EEAR;
+volatile uint8_t UCSR0B, UCSR0C;
+volatile uint16_t UBRR0;
+
+static volatile uint8_t SIM_Adcsra;
+static volatile uint8_t SIM_Tcnt0;
+static volatile uint16_t SIM_Tcnt1;
+static volatile uint8_t SIM_Eecr, SIM_Eedr;
+static volatile uint8_t SIM_Ucsr0a = 0x20, SIM_Udr0; // UDRE0 set after reset
+
+// VIRTUAL TIME
+static uint64_t SIM_Now = 0;          // us since reset
+static uint64_t SIM_End;              // us
+static uint64_t SIM_T0Next = 0;       // next timer0 overflow, 0 while stopped
+static uint64_t SIM_T0Start = 0;      // last timer0 overflow
+static uint64_t SIM_KeyNext = SIM_KEY_PERIOD_US;
+static uint8_t SIM_KeyDown = 0;       // 0 or key number held
+static unsigned long SIM_KeyIndex = 0;
+static uint8_t SIM_InIsr = 0;
+static uint8_t SIM_T0Pending = 0;
+static uint64_t SIM_AdcNext = 0;      // end of the conversion in progress, 0 when none
+static uint8_t SIM_AdcPending = 0;
+static uint8_t SIM_Asleep = 0;        // in HAL_Sleep, a burst may run past the first conversion
+static uint64_t SIM_EeNext = 0;       // end of the EEPROM write in progress, 0 when idle
+
+// EEPROM CONTENT
+static uint8_t SIM_Eeprom[SIM_EE_SIZE];
+static const char *SIM_EepromFile = 0;
+static uint64_t SIM_EeWrites = 0;
+
+// USART, one byte in the shift register and one in UDR0
+static uint8_t SIM_UdrWritten = 0;    // UDR0 was accessed, the byte is taken on the next sync
+static uint64_t SIM_UartShiftEnd = 0; // end of the byte being shifted out, 0 when idle
+static uint8_t SIM_UartBuffered = 0;  // UDR0 holds a byte waiting for the shift register
+static uint8_t SIM_UartNext;
+static FILE *SIM_UartFile = 0;
+static uint64_t SIM_UartBytes = 0;
+static uint64_t SIM_UartIsrCalls = 0, SIM_UartIsrNs = 0;
+
+// STATISTICS
+static struct timespec SIM_WallStart;
+static uint64_t SIM_IsrCalls = 0, SIM_IsrNs = 0;
+static uint64_t SIM_Spans = 0, SIM_SpanNs = 0;
+static uint64_t SIM_MenuSpans = 0, SIM_MenuNs = 0;
+static uint64_t SIM_AdcConversions = 0, SIM_AdcSingle = 0, SIM_AdcNr = 0;
+static uint64_t SIM_SpanStart = 0;
+static uint64_t SIM_MenuArmedAt = 0;  // virtual time the last scripted press reaches the queue
+static uint8_t SIM_MenuSpan = 0;
+static uint32_t SIM_Noise = 1;
+
+// PLANT STATE AND TRACE
+static double SIM_Ambient = SIM_AMBIENT_DEFAULT;
+static double SIM_Room, SIM_Sensor;   // C
+static uint8_t SIM_HeaterOn = 0;
+static uint64_t SIM_HeaterSwitches = 0;
+static uint64_t SIM_HeaterOnUs = 0;
+static float *SIM_Trace = 0;          // sensor temperature once per second
+static size_t SIM_TraceLen = 0, SIM_TraceCap = 0;
+static uint64_t SIM_TraceNext = 0;
+
+// Weak defaults for vectors a build does not use
+__attribute__((weak)) void ADC_vect(void) {}
+__attribute__((weak)) void PCINT0_vect(void) {}
+__attribute__((weak)) void TIMER0_OVF_vect(void) {}
+__attribute__((weak)) void EE_READY_vect(void) {}
+__attribute__((weak)) void USART_UDRE_vect(void) {}
+
+static uint64_t SIM_WallNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static const uint16_t SIM_Prescaler[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+
+// virtual us for a number of timer clocks
+static uint64_t SIM_TimerPeriodUs(uint8_t tccrb, uint16_t counts)
+{
+    uint16_t presc = SIM_Prescaler[tccrb & 0x07];
+    return presc ? (uint64_t)counts * presc / (HAL_SIM_F_CPU / 1000000UL) : 0;
+}
+
+// settling against the mean of the last 10% of the run
+static void SIM_PlantReport(void)
+{
+    size_t i, tail = SIM_TraceLen / 10, settle = 0;
+    double final = 0, peak = -1e9;
+    double hours = SIM_Now / 3.6e9;
+
+    if (tail == 0)
+    {
+        return;
+    }
+    for (i = SIM_TraceLen - tail; i < SIM_TraceLen; i++)
+    {
+        final += SIM_Trace[i];
+    }
+    final /= tail;
+    for (i = 0; i < SIM_TraceLen; i++)
+    {
+        if (SIM_Trace[i] > peak)
+        {
+            peak = SIM_Trace[i];
+        }
+        if (SIM_Trace[i] > final + SIM_SETTLE_BAND || SIM_Trace[i] < final - SIM_SETTLE_BAND)
+        {
+            settle = i + 1;
+        }
+    }
+
+    printf("room temperature    : %.2f C final, %.2f C overshoot, settled (+-%.1f C) after %zu s\n",
+           final, peak > final ? peak - final : 0.0, SIM_SETTLE_BAND, settle);
+    printf("heater relay        : %llu switches (%.1f per hour), on %.1f%%\n", (unsigned long long)SIM_HeaterSwitches,
+           hours > 0 ? SIM_HeaterSwitches / hours : 0.0, SIM_Now ? 100.0 * SIM_HeaterOnUs / SIM_Now : 0.0);
+}
+
+static uint64_t SIM_UartByteUs(void)
+{
+    // 10 bits of F_CPU / (8 or 16 * (UBRR0 + 1)) baud
+    uint64_t us = 10ULL * ((SIM_Ucsr0a & (1 << 1)) ? 8 : 16) * (UBRR0 + 1) / (HAL_SIM_F_CPU / 1000000UL);
+    return us ? us : 1;
+}
+
+static void SIM_UartReport(void)
+{
+    double secs = SIM_Now / 1e6;
+    double rate = secs > 0 ? SIM_UartBytes / secs : 0.0;
+
+    printf("uart tx             : %llu bytes (%.1f B/s, %.2f%% of the line)\n", (unsigned long long)SIM_UartBytes, rate,
+           100.0 * rate * SIM_UartByteUs() / 1e6);
+    printf("ns per UDRE ISR     : %.1f (%llu calls)\n", SIM_UartIsrCalls ? (double)SIM_UartIsrNs / SIM_UartIsrCalls : 0.0,
+           (unsigned long long)SIM_UartIsrCalls);
+    if (SIM_UartFile)
+    {
+        fclose(SIM_UartFile);
+    }
+}
+
+static void SIM_Report(void)
+{
+    uint64_t wall = SIM_WallNs() - ((uint64_t)SIM_WallStart.tv_sec * 1000000000ULL + SIM_WallStart.tv_nsec);
+    double secs = wall / 1e9;
+
+    printf("virtual time        : %llu s\n", (unsigned long long)(SIM_Now / 1000000ULL));
+    printf("wall time           : %.3f s\n", secs);
+    printf("timer0 ticks        : %llu (%.2f M ticks/s)\n", (unsigned long long)SIM_IsrCalls,
+           secs > 0 ? SIM_IsrCalls / secs / 1e6 : 0.0);
+    printf("ns per tick ISR     : %.1f\n", SIM_IsrCalls ? (double)SIM_IsrNs / SIM_IsrCalls : 0.0);
+    printf("ns per main wake    : %.1f (%llu wakes)\n", SIM_Spans ? (double)SIM_SpanNs / SIM_Spans : 0.0,
+           (unsigned long long)SIM_Spans);
+    printf("ns per menu step    : %.1f (%llu steps)\n", SIM_MenuSpans ? (double)SIM_MenuNs / SIM_MenuSpans : 0.0,
+           (unsigned long long)SIM_MenuSpans);
+    SIM_PlantReport();
+    printf("eeprom writes       : %llu bytes\n", (unsigned long long)SIM_EeWrites);
+    printf("adc conversions     : %llu, %llu single (%.1f%% of them in noise reduction sleep)\n",
+           (unsigned long long)SIM_AdcConversions, (unsigned long long)SIM_AdcSingle,
+           SIM_AdcSingle ? 100.0 * SIM_AdcNr / SIM_AdcSingle : 0.0);
+    SIM_UartReport();
+
+    if (SIM_EepromFile)
+    {
+        FILE *f = fopen(SIM_EepromFile, "wb");
+        if (f)
+        {
+            fwrite(SIM_Eeprom, 1, sizeof(SIM_Eeprom), f);
+            fclose(f);
+        }
+    }
+}
+
+__attribute__((constructor)) static void SIM_Start(void)
+{
+    const char *secs = getenv("HAL_SIM_SECONDS");
+    const char *keys = getenv("HAL_SIM_KEYS");
+    const char *ambient = getenv("HAL_SIM_AMBIENT");
+    const char *mcusr = getenv("HAL_SIM_MCUSR");
+    const char *uart = getenv("HAL_SIM_UART");
+    FILE *f;
+    SIM_End = (uint64_t)(secs ? strtoul(secs, 0, 10) : SIM_SECONDS_DEFAULT) * 1000000ULL;
+    if (keys && *keys)
+    {
+        SIM_KeyLoop = keys;
+        SIM_KeyOnce = 1;
+    }
+    if (mcusr)
+    {
+        MCUSR = (uint8_t)strtoul(mcusr, 0, 0);
+    }
+    if (ambient)
+    {
+        SIM_Ambient = strtod(ambient, 0);
+    }
+    SIM_Room = SIM_Sensor = SIM_Ambient;
+    if (uart && *uart && !(SIM_UartFile = fopen(uart, "wb")))
+    {
+        perror(uart);
+    }
+
+    // erased EEPROM, or the image of the previous run
+    memset(SIM_Eeprom, 0xff, sizeof(SIM_Eeprom));
+    SIM_EepromFile = getenv("HAL_SIM_EEPROM");
+    if (SIM_EepromFile && (f = fopen(SIM_EepromFile, "rb")))
+    {
+        if (fread(SIM_Eeprom, 1, sizeof(SIM_Eeprom), f) != sizeof(SIM_Eeprom))
+        {
+            memset(SIM_Eeprom, 0xff, sizeof(SIM_Eeprom));
+        }
+        fclose(f);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &SIM_WallStart);
+    atexit(SIM_Report);
+    SIM_SpanStart = SIM_WallNs();
+}
+
+// ANALOG INPUTS, nominal value plus a little noise
+static uint16_t SIM_Analog(uint8_t channel)
+{
+    int16_t v;
+
+    SIM_Noise = SIM_Noise * 1103515245UL + 12345UL;
+    v = (int16_t)((SIM_Noise >> 16) & 0x03) - 1;
+
+    switch (channel)
+    {
+    case 1:
+        v += 180; // load cell, ~60 on the weight scale
+        break;
+    case 2:
+        v += 74; // body temperature, 36.1 C
+        break;
+    case 3:
+        v += (int16_t)(SIM_Sensor * 1024 / 500 + 0.5); // room temperature from the plant, LM35 on 5V
+        break;
+    default:
+        v = 0;
+        break;
+    }
+    return v < 0 ? 0 : (v > 1023 ? 1023 : v);
+}
+
+// runs a vector like the hardware would, with the I bit cleared
+static uint8_t SIM_Interrupt(void (*vector)(void))
+{
+    if (!(SREG & 0x80) || SIM_InIsr)
+    {
+        return 0;
+    }
+    SIM_InIsr = 1;
+    SREG &= (uint8_t)~0x80;
+    vector();
+    SREG |= 0x80;
+    SIM_InIsr = 0;
+    return 1;
+}
+
+static void SIM_ConvertOne(void)
+{
+    // free running (ADTS = 000), the next conversion starts as this one ends
+    uint8_t again = (SIM_Adcsra & 0xa0) == 0xa0 && (ADCSRB & 0x07) == 0x00;
+
+    SIM_AdcConversions++;
+    ADC = SIM_Analog(ADMUX & 0x0f);
+    SIM_Adcsra &= (uint8_t)~(1 << 6); // ADSC
+    SIM_Adcsra |= (1 << 4);           // ADIF
+    SIM_AdcPending = 0;
+    if (SIM_Adcsra & (1 << 3))
+    {
+        if (SIM_Interrupt(ADC_vect))
+        {
+            SIM_Adcsra &= (uint8_t)~(1 << 4);
+        }
+        else
+        {
+            SIM_AdcPending = 1;
+        }
+    }
+
+    SIM_AdcNext = again ? SIM_Now + SIM_ADC_CONV_US : 0;
+}
+
+// next event of any source but the ADC
+static uint64_t SIM_NextOther(void)
+{
+    uint64_t next = SIM_KeyNext;
+
+    if (SIM_T0Next && SIM_T0Next < next)
+    {
+        next = SIM_T0Next;
+    }
+    if (SIM_EeNext && SIM_EeNext < next)
+    {
+        next = SIM_EeNext;
+    }
+    if (SIM_UartShiftEnd && SIM_UartShiftEnd < next)
+    {
+        next = SIM_UartShiftEnd;
+    }
+    return next;
+}
+
+static uint64_t SIM_NextEvent(void)
+{
+    uint64_t next = SIM_NextOther();
+
+    return SIM_AdcNext && SIM_AdcNext < next ? SIM_AdcNext : next;
+}
+
+/* A free running burst (the 64 conversions of an oversampled channel) is
+one event while the CPU sleeps and nothing else falls due: between its
+conversions the CPU would only wake to go back to sleep. Otherwise the
+conversions stop at limit, the end of a delay.
+*/
+static void SIM_Convert(uint64_t limit)
+{
+    uint64_t other;
+
+    SIM_ConvertOne();
+    other = SIM_NextOther();
+    while (SIM_AdcNext && !SIM_AdcPending && SIM_AdcNext < other && SIM_AdcNext <= limit)
+    {
+        SIM_Now = SIM_AdcNext;
+        SIM_ConvertOne();
+    }
+}
+
+// one euler step of the plant per timer0 overflow
+static void SIM_Plant(uint64_t dt_us)
+{
+    double dt = dt_us / 1e6;
+    uint8_t on = (PORTB >> SIM_HEATER_BIT) & 1;
+
+    if (on != SIM_HeaterOn)
+    {
+        SIM_HeaterOn = on;
+        SIM_HeaterSwitches++;
+    }
+    if (on)
+    {
+        SIM_HeaterOnUs += dt_us;
+    }
+    SIM_Room += dt * ((SIM_Ambient + on * SIM_HEATER_RISE) - SIM_Room) / SIM_ROOM_TAU_S;
+    SIM_Sensor += dt * (SIM_Room - SIM_Sensor) / SIM_SENSOR_TAU_S;
+
+    if (SIM_Now >= SIM_TraceNext)
+    {
+        SIM_TraceNext += 1000000ULL;
+        if (SIM_TraceLen == SIM_TraceCap)
+        {
+            SIM_TraceCap = SIM_TraceCap ? 2 * SIM_TraceCap : 4096;
+            SIM_Trace = realloc(SIM_Trace, SIM_TraceCap * sizeof(*SIM_Trace));
+            if (!SIM_Trace)
+            {
+                exit(1);
+            }
+        }
+        SIM_Trace[SIM_TraceLen++] = (float)SIM_Sensor;
+    }
+}
+
+static void SIM_Timer0Overflow(void)
+{
+    uint64_t start = SIM_WallNs();
+
+    SIM_Plant(SIM_Now - SIM_T0Start);
+    SIM_T0Start = SIM_T0Next;
+    SIM_T0Next += SIM_TimerPeriodUs(TCCR0B, 256);
+
+    if (TIMSK0 & 0x01)
+    {
+        if (SIM_Interrupt(TIMER0_OVF_vect))
+        {
+            SIM_IsrCalls++;
+            SIM_IsrNs += SIM_WallNs() - start;
+        }
+        else
+        {
+            SIM_T0Pending = 1;
+        }
+    }
+
+    // ADC auto trigger source timer0 overflow
+    if ((SIM_Adcsra & 0xa0) == 0xa0 && (ADCSRB & 0x07) == 0x04)
+    {
+        SIM_ConvertOne();
+    }
+}
+
+/* EEPROM, register writes take effect on the next access or event.
+EERE loads EEDR, EEPE with EEMPE starts a write that keeps EEPE set for
+SIM_EE_WRITE_US, the ready interrupt is a level while EERIE is set and
+no write is in progress.
+*/
+static void SIM_EeSync(void)
+{
+    if (SIM_Eecr & (1 << 0)) // EERE
+    {
+        SIM_Eecr &= (uint8_t)~(1 << 0);
+        SIM_Eedr = SIM_Eeprom[EEAR % SIM_EE_SIZE];
+    }
+    if (SIM_EeNext && SIM_Now >= SIM_EeNext)
+    {
+        SIM_EeNext = 0;
+        SIM_Eecr &= (uint8_t)~((1 << 1) | (1 << 2));
+    }
+    if ((SIM_Eecr & 0x06) == 0x06 && !SIM_EeNext) // EEMPE and EEPE
+    {
+        SIM_Eeprom[EEAR % SIM_EE_SIZE] = SIM_Eedr;
+        SIM_EeWrites++;
+        SIM_EeNext = SIM_Now + SIM_EE_WRITE_US;
+    }
+}
+
+static void SIM_EeReady(void)
+{
+    SIM_EeSync();
+    while ((SIM_Eecr & (1 << 3)) && !SIM_EeNext && (SREG & 0x80) && !SIM_InIsr)
+    {
+        SIM_Interrupt(EE_READY_vect);
+        SIM_EeSync();
+    }
+}
+
+/* USART
+The byte of a UDR0 access is taken on the next sync (the firmware only
+writes UDR0). It goes straight to the shift register when that is idle,
+else waits in UDR0 with UDRE0 cleared. The data register empty interrupt
+is a level while UDRIE0 and UDRE0 are set.
+*/
+static void SIM_UartShift(uint8_t b, uint64_t start)
+{
+    SIM_UartBytes++;
+    SIM_UartShiftEnd = start + SIM_UartByteUs();
+    if (SIM_UartFile)
+    {
+        fputc(b, SIM_UartFile);
+    }
+}
+
+static void SIM_UartSync(void)
+{
+    if (SIM_UdrWritten)
+    {
+        SIM_UdrWritten = 0;
+        if (UCSR0B & (1 << 3)) // TXEN0
+        {
+            if (!SIM_UartShiftEnd)
+            {
+                SIM_UartShift(SIM_Udr0, SIM_Now);
+            }
+            else
+            {
+                SIM_UartBuffered = 1;
+                SIM_UartNext = SIM_Udr0;
+            }
+        }
+    }
+    while (SIM_UartShiftEnd && SIM_Now >= SIM_UartShiftEnd)
+    {
+        if (SIM_UartBuffered)
+        {
+            SIM_UartBuffered = 0;
+            SIM_UartShift(SIM_UartNext, SIM_UartShiftEnd);
+        }
+        else
+        {
+            SIM_UartShiftEnd = 0;
+        }
+    }
+    if (SIM_UartBuffered)
+    {
+        SIM_Ucsr0a &= (uint8_t)~(1 << 5);
+    }
+    else
+    {
+        SIM_Ucsr0a |= (1 << 5); // UDRE0
+    }
+    // TXC0, the firmware clears it with every byte it sends
+    if (SIM_UartShiftEnd || SIM_UartBuffered)
+    {
+        SIM_Ucsr0a &= (uint8_t)~(1 << 6);
+    }
+    else
+    {
+        SIM_Ucsr0a |= (1 << 6);
+    }
+}
+
+static void SIM_UartReady(void)
+{
+    SIM_UartSync();
+    while ((UCSR0B & (1 << 5)) && (SIM_Ucsr0a & (1 << 5)) && (SREG & 0x80) && !SIM_InIsr)
+    {
+        uint64_t t = SIM_WallNs();
+        SIM_Interrupt(USART_UDRE_vect);
+        SIM_UartIsrNs += SIM_WallNs() - t;
+        SIM_UartIsrCalls++;
+        SIM_UartSync();
+    }
+}
+
+static void SIM_KeyEdge(void)
+{
+    uint8_t old = PINB;
+
+    if (SIM_KeyDown)
+    {
+        PINB |= (1 << (SIM_KeyDown - 1));
+        SIM_KeyDown = 0;
+        SIM_KeyNext = SIM_Now + SIM_KEY_PERIOD_US - SIM_KEY_HOLD_US;
+    }
+    else
+    {
+        const char *k;
+        if (SIM_KeyIndex < sizeof(SIM_KeyScript) - 1)
+        {
+            k = &SIM_KeyScript[SIM_KeyIndex];
+        }
+        else if (SIM_KeyOnce && SIM_KeyIndex - (sizeof(SIM_KeyScript) - 1) == strlen(SIM_KeyLoop))
+        {
+            SIM_KeyNext = UINT64_MAX; // script done
+            return;
+        }
+        else
+        {
+            k = &SIM_KeyLoop[(SIM_KeyIndex - (sizeof(SIM_KeyScript) - 1)) % strlen(SIM_KeyLoop)];
+        }
+        SIM_KeyIndex++;
+        SIM_KeyDown = *k - '0';
+        PINB &= (uint8_t)~(1 << (SIM_KeyDown - 1));
+        SIM_KeyNext = SIM_Now + SIM_KEY_HOLD_US;
+        SIM_MenuArmedAt = SIM_Now + SIM_DEBOUNCE_US;
+    }
+
+    if ((PCICR & 0x01) && ((old ^ PINB) & PCMSK0))
+    {
+        SIM_Interrupt(PCINT0_vect);
+    }
+}
+
+static void SIM_UpdateTimers(void)
+{
+    // timer0 starts counting the moment its clock is selected
+    if (SIM_T0Next == 0 && (TCCR0B & 0x07))
+    {
+        SIM_T0Start = SIM_Now;
+        SIM_T0Next = SIM_Now + SIM_TimerPeriodUs(TCCR0B, 256);
+    }
+    // interrupt driven conversion started with ADSC
+    if ((SIM_Adcsra & 0xc8) == 0xc8 && !SIM_AdcNext)
+    {
+        SIM_AdcSingle++;
+        SIM_AdcNext = SIM_Now + SIM_ADC_CONV_US;
+    }
+}
+
+void HAL_SimAdvance(uint32_t us)
+{
+    uint64_t target = SIM_Now + us;
+    uint64_t limit = SIM_Asleep ? UINT64_MAX : target;
+
+    // nested delay inside an ISR, time passes without events
+    if (SIM_InIsr)
+    {
+        SIM_Now = target;
+        return;
+    }
+
+    for (;;)
+    {
+        uint64_t next;
+
+        SIM_UpdateTimers();
+        if (SIM_T0Pending && (SREG & 0x80))
+        {
+            SIM_T0Pending = 0;
+            SIM_Interrupt(TIMER0_OVF_vect);
+        }
+        if (SIM_AdcPending && (SREG & 0x80))
+        {
+            SIM_AdcPending = 0;
+            SIM_Interrupt(ADC_vect);
+            SIM_Adcsra &= (uint8_t)~(1 << 4);
+        }
+        SIM_EeReady();
+        SIM_UartReady();
+
+        next = SIM_NextEvent();
+        if (next > target)
+        {
+            break;
+        }
+        SIM_Now = next;
+        if (next == SIM_EeNext)
+        {
+            SIM_EeReady();
+        }
+        else if (next == SIM_UartShiftEnd)
+        {
+            SIM_UartReady();
+        }
+        else if (next == SIM_AdcNext)
+        {
+            SIM_Convert(limit);
+        }
+        else if (next == SIM_T0Next)
+        {
+            SIM_Timer0Overflow();
+        }
+        else
+        {
+            SIM_KeyEdge();
+        }
+    }
+    if (SIM_Now < target)
+    {
+        SIM_Now = target;
+    }
+
+    if (SIM_Now >= SIM_End)
+    {
+        exit(0);
+    }
+}
+
+void HAL_Sleep(uint8_t mode)
+{
+    uint64_t now = SIM_WallNs();
+    uint64_t next;
+
+    SREG |= 0x80;
+    // ADC noise reduction (SM = 001) with the ADC enabled and idle starts a conversion
+    if (mode == 1 && (SIM_Adcsra & 0xc0) == 0x80)
+    {
+        SIM_Adcsra |= (1 << 6);
+        SIM_AdcNr++;
+    }
+
+    // close the busy span that ends here
+    SIM_Spans++;
+    SIM_SpanNs += now - SIM_SpanStart;
+    if (SIM_MenuSpan)
+    {
+        SIM_MenuSpans++;
+        SIM_MenuNs += now - SIM_SpanStart;
+        SIM_MenuSpan = 0;
+    }
+
+    SIM_UpdateTimers();
+    next = SIM_NextEvent();
+    SIM_Asleep = 1;
+    HAL_SimAdvance(next > SIM_Now ? (uint32_t)(next - SIM_Now) : 1);
+    SIM_Asleep = 0;
+
+    if (SIM_MenuArmedAt && SIM_Now >= SIM_MenuArmedAt)
+    {
+        SIM_MenuArmedAt = 0;
+        SIM_MenuSpan = 1;
+    }
+    SIM_SpanStart = SIM_WallNs();
+}
+
+volatile uint8_t *HAL_SimAdcsra(void)
+{
+    // polled single conversion (no ADATE, no ADIE) finishes on the next access
+    if ((SIM_Adcsra & 0xe8) == 0xc0)
+    {
+        SIM_ConvertOne();
+    }
+    return &SIM_Adcsra;
+}
+
+volatile uint8_t *HAL_SimTcnt0(void)
+{
+    uint64_t per = SIM_TimerPeriodUs(TCCR0B, 1);
+    SIM_Tcnt0 = (per && SIM_T0Next) ? (uint8_t)((SIM_Now - SIM_T0Start) / per) : 0;
+    return &SIM_Tcnt0;
+}
+
+volatile uint8_t *HAL_SimEecr(void)
+{
+    SIM_EeSync();
+    return &SIM_Eecr;
+}
+
+volatile uint8_t *HAL_SimEedr(void)
+{
+    SIM_EeSync();
+    return &SIM_Eedr;
+}
+
+volatile uint8_t *HAL_SimUcsr0a(void)
+{
+    SIM_UartSync();
+    return &SIM_Ucsr0a;
+}
+
+volatile uint8_t *HAL_SimUdr0(void)
+{
+    SIM_UartSync();
+    SIM_UdrWritten = 1;
+    return &SIM_Udr0;
+}
+
+volatile uint16_t *HAL_SimTcnt1(void)
+{
+    uint16_t presc = SIM_Prescaler[TCCR1B & 0x07];
+    SIM_Tcnt1 = presc ? (uint16_t)(SIM_Now * (HAL_SIM_F_CPU / 1000000UL) / presc) : 0;
+    return &SIM_Tcnt1;
+}
+
+#endif
@@ -0,0 +1,88 @@
+#include "heater.h"
+
+#define HEATER_OUT_MAX ((s32)HEATER_WINDOW_STEPS << 8) // Q8
+
+void HEATER_Init(HEATER_t *h)
+{
+    h->integral = 0;
+    h->output = 0;
+    h->on_steps = 0;
+    h->step = 0;
+    h->odd = 0;
+    h->pid_step = 0;
+}
+
+static void HEATER_Pid(HEATER_t *h, temp_dC_t temp, temp_dC_t setpoint)
+{
+    s16 error = setpoint - temp;
+    s32 p = (s32)HEATER_KP * error;
+    s32 out = p + h->integral;
+    s32 i = h->integral + (s32)HEATER_KI * error;
+
+    // anti windup, integrate only while the output is not pushed further into saturation
+    if ((out < HEATER_OUT_MAX || error < 0) && (out > 0 || error > 0))
+    {
+        if (i < 0)
+        {
+            i = 0;
+        }
+        else if (i > HEATER_OUT_MAX)
+        {
+            i = HEATER_OUT_MAX;
+        }
+        h->integral = i;
+        out = p + i;
+    }
+
+    if (out <= 0)
+    {
+        h->output = 0;
+    }
+    else if (out >= HEATER_OUT_MAX)
+    {
+        h->output = HEATER_WINDOW_STEPS;
+    }
+    else
+    {
+        h->output = (u16)((out + 128) >> 8);
+    }
+}
+
+u8 HEATER_Run(HEATER_t *h, temp_dC_t temp, temp_dC_t setpoint, u8 enable)
+{
+    if (!enable)
+    {
+        HEATER_Init(h);
+        return 0;
+    }
+
+    if (h->pid_step == 0)
+    {
+        HEATER_Pid(h, temp, setpoint);
+    }
+    h->pid_step = h->pid_step + 1 == HEATER_PID_STEPS ? 0 : h->pid_step + 1;
+
+    // latch the on time at the window start
+    if (h->step == 0)
+    {
+        h->odd ^= 1;
+        h->on_steps = h->output;
+        if (h->on_steps < HEATER_MIN_STEPS)
+        {
+            h->on_steps = 0;
+        }
+        else if (h->on_steps > HEATER_WINDOW_STEPS - HEATER_MIN_STEPS)
+        {
+            h->on_steps = HEATER_WINDOW_STEPS;
+        }
+    }
+
+    u8 on = h->odd ? h->step >= HEATER_WINDOW_STEPS - h->on_steps : h->step < h->on_steps;
+    h->step = h->step + 1 == HEATER_WINDOW_STEPS ? 0 : h->step + 1;
+    return on;
+}
+
+u16 HEATER_Duty(const HEATER_t *h)
+{
+    return h->output;
+}
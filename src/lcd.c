@@ -1,39 +1,57 @@
 
 
-#include "LCD.h"
+#include "lcd.h"
 
 #include "DIO.h"
-#include "avr/io.h"
-#include "util/delay.h"
+#include "hal.h"
 
-#define LCD_DPRT 'D' // LCD DATA PORT
-#define LCD_CPRT 'D' // LCD COMMANDS PORT
-#define LCD_RS 2     // LCD RS
-#define LCD_RW 1     // LCD RW
-#define LCD_EN 0     // LCD EN
+#define LCD_DPRT D      // LCD DATA PORT (D4..D7 on bits 4..7 in 4 bit mode)
+#define LCD_RS_IO D, 2 // LCD RS
+#define LCD_RW_IO D, 1 // LCD RW
+#define LCD_EN_IO D, 0 // LCD EN
+
+#if LCD_RW_TIED
+#define LCD_RW_OUTPUT()
+#define LCD_RW_LOW()
+#else
+#define LCD_RW_OUTPUT() DIO_PIN_OUTPUT(LCD_RW_IO)
+#define LCD_RW_LOW() DIO_PIN_LOW(LCD_RW_IO)
+#endif
 
 static void LCD_LatchSignal(void);
 
+// SHADOW FRAMEBUFFER
+// drawing functions only touch RAM, LCD_Flush sends the cells that differ
+static unsigned char LCD_Shadow[LCD_ROWS * LCD_COLS]; // what should be on screen
+static unsigned char LCD_Shown[LCD_ROWS * LCD_COLS];  // what the controller shows
+static const unsigned char *LCD_Glyph[LCD_GLYPH_SLOTS]; // flash pattern in each CGRAM slot
+static unsigned char LCD_GlyphUsed[LCD_GLYPH_SLOTS];    // LCD_GlyphClock when last drawn
+static unsigned char LCD_GlyphClock = 0;
+static volatile unsigned char LCD_CgramDirty = 0;     // one bit per glyph waiting for upload
+static volatile unsigned char LCD_Changed = 0;        // set by writers, cleared by the flusher
+static unsigned char LCD_CursorX = 0, LCD_CursorY = 0; // drawing cursor (row, column)
+static unsigned char LCD_HwAddr = 0xff;               // controller DDRAM address, 0xff unknown
+static unsigned char LCD_Ready = 0;                   // flusher stays off until LCD_Init is done
+static unsigned char LCD_Banner[LCD_COLS];            // overlay for the first row
+static volatile unsigned char LCD_BannerOn = 0;
+
 void LCD_Init()
 {
 #if LCD_MODE == LCD_8BIT_MODE
-    DIO_SetPortDirection(LCD_DPRT, OUTPUT);
-    DIO_SetPinDirection(LCD_CPRT, LCD_RS, OUTPUT);
-    DIO_SetPinDirection(LCD_CPRT, LCD_RW, OUTPUT);
-    DIO_SetPinDirection(LCD_CPRT, LCD_EN, OUTPUT);
+    DIO_DDR(LCD_DPRT) = 0xff;
+    DIO_PIN_OUTPUT(LCD_RS_IO);
+    LCD_RW_OUTPUT();
+    DIO_PIN_OUTPUT(LCD_EN_IO);
     LCD_SendCommand(0x38);
     LCD_SendCommand(0x0E);
     LCD_SendCommand(0x01);
     _delay_ms(2);
 #elif LCD_MODE == LCD_4BIT_MODE
     /// TODO:
-    DIO_SetPinDirection(LCD_DPRT, 4, OUTPUT);
-    DIO_SetPinDirection(LCD_DPRT, 5, OUTPUT);
-    DIO_SetPinDirection(LCD_DPRT, 6, OUTPUT);
-    DIO_SetPinDirection(LCD_DPRT, 7, OUTPUT);
-    DIO_SetPinDirection(LCD_CPRT, LCD_RS, OUTPUT);
-    DIO_SetPinDirection(LCD_CPRT, LCD_RW, OUTPUT);
-    DIO_SetPinDirection(LCD_CPRT, LCD_EN, OUTPUT);
+    DIO_DDR(LCD_DPRT) |= 0xf0;
+    DIO_PIN_OUTPUT(LCD_RS_IO);
+    LCD_RW_OUTPUT();
+    DIO_PIN_OUTPUT(LCD_EN_IO);
     LCD_SendCommand(0x33);
     LCD_SendCommand(0x32);
     LCD_SendCommand(0x28);
@@ -43,22 +61,30 @@ void LCD_Init()
 #else
 #error Please Select The Correct Mode of LCD
 #endif
+    // display was just cleared, start the framebuffer from the same state
+    for (unsigned char i = 0; i < LCD_ROWS * LCD_COLS; i++)
+    {
+        LCD_Shown[i] = ' ';
+    }
+    lcd_clear();
+    LCD_HwAddr = 0;
+    LCD_Ready = 1;
 }
 
 void LCD_SendCommand(unsigned char Command)
 {
 #if LCD_MODE == LCD_8BIT_MODE
-    DIO_WritePort(LCD_DPRT, Command);
-    DIO_WritePin(LCD_CPRT, LCD_RS, 0);
-    DIO_WritePin(LCD_CPRT, LCD_RW, 0);
+    DIO_PORT(LCD_DPRT) = Command;
+    DIO_PIN_LOW(LCD_RS_IO);
+    LCD_RW_LOW();
     LCD_LatchSignal();
 #elif LCD_MODE == LCD_4BIT_MODE
     /// TODO:
-    DIO_WritePin(LCD_CPRT, LCD_RS, 0);
-    DIO_WritePin(LCD_CPRT, LCD_RW, 0);
-    PORTD = (PORTD & 0x0f) | (Command & 0xf0);
+    DIO_PIN_LOW(LCD_RS_IO);
+    LCD_RW_LOW();
+    DIO_PORT(LCD_DPRT) = (DIO_PORT(LCD_DPRT) & 0x0f) | (Command & 0xf0);
     LCD_LatchSignal();
-    PORTD = (PORTD & 0x0f) | (Command << 4);
+    DIO_PORT(LCD_DPRT) = (DIO_PORT(LCD_DPRT) & 0x0f) | (Command << 4);
     LCD_LatchSignal();
 
 #else
@@ -69,20 +95,18 @@ void LCD_SendCommand(unsigned char Command)
 void LCD_SendData(unsigned char Data)
 {
 #if LCD_MODE == LCD_8BIT_MODE
-    DIO_WritePort(LCD_DPRT, Data);
+    DIO_PORT(LCD_DPRT) = Data;
 
-    DIO_WritePin(LCD_CPRT, LCD_RS, 1);
-    DIO_WritePin(LCD_CPRT, LCD_RW, 0);
+    DIO_PIN_HIGH(LCD_RS_IO);
+    LCD_RW_LOW();
     LCD_LatchSignal();
 #elif LCD_MODE == LCD_4BIT_MODE
-    DIO_WritePin(LCD_CPRT, LCD_RS, 1);
-    DIO_WritePin(LCD_CPRT, LCD_RW, 0);
+    DIO_PIN_HIGH(LCD_RS_IO);
+    LCD_RW_LOW();
 
-    DIO_WritePort(LCD_DPRT, (DIO_ReadPort(LCD_DPRT) & 0x0f) | (Data & 0xf0));
-    // PORTD=(PORTD & 0x0f)|(Data&0xf0);
+    DIO_PORT(LCD_DPRT) = (DIO_PORT(LCD_DPRT) & 0x0f) | (Data & 0xf0);
     LCD_LatchSignal();
-    DIO_WritePort(LCD_DPRT, (DIO_ReadPort(LCD_DPRT) & 0x0f) | (Data << 4));
-    // PORTD=(PORTD&0x0f)|(Data<<4);
+    DIO_PORT(LCD_DPRT) = (DIO_PORT(LCD_DPRT) & 0x0f) | (Data << 4);
     LCD_LatchSignal();
 
 #else
@@ -92,73 +116,301 @@ void LCD_SendData(unsigned char Data)
 
 void lcd_setcursor(unsigned char x, unsigned char y)
 {
+    LCD_CursorX = x;
+    LCD_CursorY = y;
+}
+
+// writes are clipped at the end of the row
+void lcd_sendchar(unsigned char Data)
+{
+    if (LCD_CursorX < LCD_ROWS && LCD_CursorY < LCD_COLS)
+    {
+        LCD_Shadow[LCD_CursorX * LCD_COLS + LCD_CursorY] = Data;
+        LCD_Changed = 1;
+    }
+    LCD_CursorY++;
+}
+
+void lcd_clear(void)
+{
+    for (unsigned char i = 0; i < LCD_ROWS * LCD_COLS; i++)
+    {
+        LCD_Shadow[i] = ' ';
+    }
+    LCD_CursorX = 0;
+    LCD_CursorY = 0;
+    LCD_Changed = 1;
+}
+
+void lcd_setbanner(const char *msg)
+{
+    unsigned char i = 0;
 
-    char address = 0;
-    if (x == 0)
+    if (msg == 0)
     {
-        address = y;
-        LCD_SendCommand(address + 128);
+        LCD_BannerOn = 0;
     }
     else
     {
-        address = 0x40 + y;
-        LCD_SendCommand(address + 128);
+        LCD_BannerOn = 0; // flusher falls back to the page while the text changes
+        for (; i < LCD_COLS && pgm_read_byte(&msg[i]) != '\0'; i++)
+        {
+            LCD_Banner[i] = pgm_read_byte(&msg[i]);
+        }
+        for (; i < LCD_COLS; i++)
+        {
+            LCD_Banner[i] = ' ';
+        }
+        LCD_BannerOn = 1;
     }
+    LCD_Changed = 1;
 }
 
 void lcd_sendstring(const char *Str)
 {
-    /// TODO:
     int i = 0;
     while (!(Str[i] == '\0'))
     {
-        LCD_SendData(Str[i]);
+        lcd_sendchar(Str[i]);
         i++;
     }
 }
-void send_specialcharachter(unsigned char *arr, char patternno, char x, char y)
+
+void lcd_sendstring_P(const char *Str)
 {
+    char ch;
 
-    char cgramaddress = 0;
-    int i;
-    cgramaddress = 8 * patternno;
-    LCD_SendCommand(cgramaddress + 64);
-    for (i = 0; i < 8; i++)
+    while ((ch = pgm_read_byte(Str++)) != '\0')
     {
-        LCD_SendData(arr[i]);
+        lcd_sendchar(ch);
     }
-    lcd_setcursor(x, y);
-    LCD_SendData(patternno);
 }
-void lcd_send_number(unsigned char numb)
+
+// slot for a glyph, a miss picks a victim and queues the upload
+static unsigned char LCD_GlyphSlot(const unsigned char *glyph)
 {
-    if (numb >= 100)
+    unsigned char i, slot = 0, shown = 0;
+    unsigned int age, oldest = 0;
+
+    for (i = 0; i < LCD_GLYPH_SLOTS; i++)
     {
-        unsigned char first = numb / 100;
-        LCD_SendData(first + '0');
-        unsigned char second = (numb / 10) % 10;
-        LCD_SendData(second + '0');
-        unsigned char third = numb % 10;
-        LCD_SendData(third + '0');
+        if (LCD_Glyph[i] == glyph)
+        {
+            return i;
+        }
     }
-    else if (numb == 0 || numb < 10)
+    // codes 0..7 on the page, evicting those would change cells on screen
+    for (i = 0; i < LCD_ROWS * LCD_COLS; i++)
     {
-        unsigned char first = numb;
-        LCD_SendData(first + '0');
+        if (LCD_Shadow[i] < LCD_GLYPH_SLOTS)
+        {
+            shown |= 1 << LCD_Shadow[i];
+        }
     }
-    else
+    for (i = 0; i < LCD_GLYPH_SLOTS; i++)
     {
-        unsigned char first = numb / 10;
-        LCD_SendData(first + '0');
-        unsigned char second = numb % 10;
-        LCD_SendData(second + '0');
+        if (LCD_Glyph[i] == 0)
+        {
+            slot = i;
+            break;
+        }
+        // wraps, ordered as long as a slot is drawn once in 256 glyph draws
+        age = (unsigned char)(LCD_GlyphClock - LCD_GlyphUsed[i]);
+        if (!(shown & (1 << i)))
+        {
+            age += 256; // off screen first
+        }
+        if (age >= oldest)
+        {
+            oldest = age;
+            slot = i;
+        }
     }
+    LCD_Glyph[slot] = glyph;
+    LCD_CgramDirty |= (1 << slot);
+    LCD_Changed = 1;
+    return slot;
+}
+
+void lcd_sendglyph_P(const unsigned char *glyph)
+{
+    unsigned char slot = LCD_GlyphSlot(glyph);
+
+    LCD_GlyphUsed[slot] = ++LCD_GlyphClock;
+    lcd_sendchar(slot);
+}
+
+/* NUMBER FORMATTING
+no hardware divider: a 16 bit value is split with a reciprocal multiply,
+a 32 bit one with double dabble (shift and add 3), no / or % on the way
+*/
+
+// decimal digits of v into buf, least significant first, returns the count
+static unsigned char LCD_Digits(u16 v, char *buf)
+{
+    unsigned char n = 0;
+    u16 q;
+
+    do
+    {
+        q = (u16)(((unsigned long)v * 52429) >> 19); // v / 10, exact for 16 bits
+        buf[n++] = '0' + (unsigned char)(v - q * 10);
+        v = q;
+    } while (v);
+    return n;
+}
+
+void lcd_send_number(u16 numb)
+{
+    char buf[5];
+    unsigned char n = LCD_Digits(numb, buf);
+
+    while (n)
+    {
+        lcd_sendchar(buf[--n]);
+    }
+}
+
+void lcd_send_number32(unsigned long numb)
+{
+    unsigned char bcd[5] = {0, 0, 0, 0, 0}; // 10 digits, bcd[0] has the lowest two
+    unsigned char i, j, carry, next, digit, started = 0;
+
+    if (numb <= 0xffff)
+    {
+        lcd_send_number((u16)numb);
+        return;
+    }
+    for (i = 0; i < 32; i++)
+    {
+        // a digit of 5 or more overflows when doubled, add 3 first
+        for (j = 0; j < 5; j++)
+        {
+            if ((bcd[j] & 0x0f) >= 0x05)
+            {
+                bcd[j] += 0x03;
+            }
+            if ((bcd[j] & 0xf0) >= 0x50)
+            {
+                bcd[j] += 0x30;
+            }
+        }
+        carry = (numb & 0x80000000UL) ? 1 : 0;
+        numb <<= 1;
+        for (j = 0; j < 5; j++)
+        {
+            next = bcd[j] >> 7;
+            bcd[j] = (bcd[j] << 1) | carry;
+            carry = next;
+        }
+    }
+    for (i = 10; i--;)
+    {
+        digit = (i & 1) ? bcd[i >> 1] >> 4 : bcd[i >> 1] & 0x0f;
+        if (digit || started || i == 0)
+        {
+            lcd_sendchar('0' + digit);
+            started = 1;
+        }
+    }
+}
+
+void lcd_send_fixed(s16 value, unsigned char decimals)
+{
+    char buf[5];
+    unsigned char n;
+    u16 u = value;
+
+    if (value < 0)
+    {
+        lcd_sendchar('-');
+        u = -u;
+    }
+    n = LCD_Digits(u, buf);
+    while (n <= decimals)
+    {
+        buf[n++] = '0'; // 0.5, not .5
+    }
+    while (n)
+    {
+        if (n == decimals)
+        {
+            lcd_sendchar('.');
+        }
+        lcd_sendchar(buf[--n]);
+    }
+}
+
+/* Sends at most LCD_FLUSH_PER_TICK changed cells (or one glyph upload)
+returns 1 if more work is pending
+*/
+unsigned char LCD_Flush(void)
+{
+    unsigned char i, addr, cell;
+    unsigned char budget = LCD_FLUSH_PER_TICK;
+
+    if (!LCD_Ready || !LCD_Changed)
+    {
+        return 0;
+    }
+    LCD_Changed = 0;
+
+    // glyphs first so a cell never shows a stale pattern
+    if (LCD_CgramDirty)
+    {
+        for (i = 0; i < 8; i++)
+        {
+            if (LCD_CgramDirty & (1 << i))
+            {
+                LCD_CgramDirty &= ~(1 << i);
+                LCD_SendCommand(64 + 8 * i);
+                for (unsigned char j = 0; j < 8; j++)
+                {
+                    LCD_SendData(pgm_read_byte(&LCD_Glyph[i][j]));
+                }
+                LCD_HwAddr = 0xff; // address counter now points into CGRAM
+                LCD_Changed = 1;
+                return 1;
+            }
+        }
+    }
+
+    for (i = 0; i < LCD_ROWS * LCD_COLS; i++)
+    {
+        cell = (LCD_BannerOn && i < LCD_COLS) ? LCD_Banner[i] : LCD_Shadow[i];
+        if (cell == LCD_Shown[i])
+        {
+            continue;
+        }
+        if (budget == 0)
+        {
+            LCD_Changed = 1;
+            return 1;
+        }
+        addr = (i < LCD_COLS) ? i : (0x40 + i - LCD_COLS);
+        if (addr != LCD_HwAddr)
+        {
+            LCD_SendCommand(addr + 128);
+        }
+        LCD_SendData(cell);
+        LCD_Shown[i] = cell;
+        LCD_HwAddr = addr + 1; // address counter auto increments
+        budget--;
+    }
+    return LCD_Changed;
+}
+
+// Blocking, flushes the whole framebuffer
+void LCD_FlushAll(void)
+{
+    while (LCD_Flush())
+        ;
 }
 
 static void LCD_LatchSignal(void)
 {
-    DIO_WritePin(LCD_CPRT, LCD_EN, 1);
+    DIO_PIN_HIGH(LCD_EN_IO);
     _delay_us(20);
-    DIO_WritePin(LCD_CPRT, LCD_EN, 0);
+    DIO_PIN_LOW(LCD_EN_IO);
     _delay_us(100);
 }
\ No newline at end of file
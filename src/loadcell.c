@@ -1,24 +1,92 @@
 #include "loadcell.h"
 
 #define OCCUPANCY_THRESHOLD_V 0.1
-#define LOADCELL_PRT 'C'
-#define LOADCELL_ADCp 0
-#define LOADCELL_ADCn 1
-#define LOADCELL_ADMUX 0b00001
+#define LOADCELL_ADCp_IO C, 0
+#define LOADCELL_ADCn_IO C, 1
 
-// Sets analog port direction, doesnt init adc
+#define LOADCELL_GAIN_HALF (1UL << (LOADCELL_GAIN_SHIFT - 1)) // rounds the weight to the nearest kg
+
+LOADCELL_Cal_t LOADCELL_Cal = {0, LOADCELL_GAIN_DEFAULT};
+static u16 LOADCELL_Zero = 0; // LOADCELL_Cal.zero moved by the zero tracking
+static u8 LOADCELL_TrackWait = 0;
+
+// Sets analog port direction and oversampling of the scanned channel, doesnt init adc
 void LOADCELL_Init(void)
 {
-    DIO_SetPinDirection(LOADCELL_PRT, LOADCELL_ADCp, INPUT);
-    DIO_SetPinDirection(LOADCELL_PRT, LOADCELL_ADCn, INPUT);
+    DIO_PIN_INPUT(LOADCELL_ADCp_IO);
+    DIO_PIN_INPUT(LOADCELL_ADCn_IO);
+    ADC_Oversample(LOADCELL_ADMUX, LOADCELL_OS_LOG2, LOADCELL_EXTRA_BITS);
+}
+
+unsigned short LOADCELL_ReadRaw(void)
+{
+    return ADC_ReadLatest(LOADCELL_ADMUX);
+}
+
+unsigned short LOADCELL_ReadWeight(void)
+{
+    u16 code = LOADCELL_ReadRaw();
+
+    if (code <= LOADCELL_Zero)
+    {
+        return 0;
+    }
+    return (unsigned short)(((u32)(code - LOADCELL_Zero) * LOADCELL_Cal.gain + LOADCELL_GAIN_HALF) >> LOADCELL_GAIN_SHIFT);
+}
+
+void LOADCELL_SetCal(const LOADCELL_Cal_t *cal)
+{
+    LOADCELL_Cal = *cal;
+    LOADCELL_Zero = cal->zero;
+}
+
+void LOADCELL_Tare(void)
+{
+    LOADCELL_Cal.zero = LOADCELL_Zero = LOADCELL_ReadRaw();
+}
+
+u8 LOADCELL_Span(u16 kg)
+{
+    u16 code = LOADCELL_ReadRaw();
+    u32 gain;
+
+    if (kg == 0 || code < LOADCELL_Zero + LOADCELL_SPAN_MIN)
+    {
+        return 0;
+    }
+    // the only division, at calibration time
+    gain = (((u32)kg << LOADCELL_GAIN_SHIFT) + (code - LOADCELL_Zero) / 2) / (code - LOADCELL_Zero);
+    if (gain == 0 || gain > 0xffff)
+    {
+        return 0;
+    }
+    LOADCELL_Cal.gain = (u16)gain;
+    LOADCELL_Cal.zero = LOADCELL_Zero; // the tracked zero the span was taken against
+    return 1;
 }
 
-// UNCALIBRATED
-float LOADCELL_ReadWeight(void)
+void LOADCELL_Track(void)
 {
+    u16 code = LOADCELL_ReadRaw();
+    u16 off = code > LOADCELL_Zero ? code - LOADCELL_Zero : LOADCELL_Zero - code;
 
-    unsigned short binary = ADC_Read(LOADCELL_ADMUX);
-    float weight = binary;
-    // TODO:calibrate weight sensing equation
-    return weight;
+    // a load, or a zero that went beyond the band: left to a tare
+    if ((((u32)off * LOADCELL_Cal.gain) >> LOADCELL_GAIN_SHIFT) >= LOADCELL_TRACK_KG)
+    {
+        LOADCELL_TrackWait = 0;
+        return;
+    }
+    if (++LOADCELL_TrackWait < LOADCELL_TRACK_STEPS)
+    {
+        return;
+    }
+    LOADCELL_TrackWait = 0;
+    if (code > LOADCELL_Zero)
+    {
+        LOADCELL_Zero++;
+    }
+    else if (code < LOADCELL_Zero)
+    {
+        LOADCELL_Zero--;
+    }
 }
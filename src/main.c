@@ -1,6 +1,4 @@
-#include <avr/io.h>
-#include <util/delay.h>
-#include <avr/interrupt.h>
+#include "hal.h"
 
 #include "ADC.h"
 #include "pushbuttons.h"
@@ -9,6 +7,19 @@
 #include "timer.h"
 #include "loadcell.h"
 #include "relay.h"
+#include "sensor.h"
+#include "scheduler.h"
+#include "profiler.h"
+#include "alarm.h"
+#include "heater.h"
+#include "bed.h"
+#include "eeprom.h"
+#include "eelog.h"
+#include "settings.h"
+#include "boot.h"
+#include "telemetry.h"
+#include "menu.h"
+#include "power.h"
 
 #define ON 1
 #define OFF 0
@@ -16,183 +27,277 @@
 
 // GLOBAL VARIABLE DEFINITIONS
 
-// MENU VARS
-unsigned char key, c, tt;
+// BED STATE (weight, temperatures, heater, lamp and mode), set by the tasks and the LCD menu
+BED_t BED;
+BED_Shared_t BED_Shared; // published copy for the UI pages and the log, see BED_Snapshot
 
-// WEIGHT
-unsigned short CURRENT_Weight = 60; // Current measured weight
-unsigned char ALARM_Weight;         // This is set if weight exceeds threshold
-unsigned short OCCUPANCY_Time = 0;  // Time current weight is above zero in seconds (for test purposes)
-#define MAX_Weight 150              // if exceeded alarm weight is initiated
+// ADC SCAN LIST (converted in the background, one channel per timer0 overflow)
+#define BODY_TEMP_ADC 2 // sensor1 at ADC A2
+#define ROOM_TEMP_ADC 3 // sensor2 at ADC A3
+const unsigned char ADC_SCAN_Channels[] = {LOADCELL_ADMUX, BODY_TEMP_ADC, ROOM_TEMP_ADC};
 
-// TEMPERATURE
-unsigned short BODY_Temp = 37;        // Body Temperature (sensor1 at ADC A2)
-unsigned char ALARM_Fever = 0;        // This is set if body temp is above 37
-unsigned short ROOM_Temp = 24;        // Room Temperature (sensor 2 at ADC A3)
-unsigned short HEATER_Threshold = 10; // Temperature to be compared with ROOM_Temp for heater relay control, is set by LCD menu
-unsigned char HEATER_Enable = 1;      // Is heater enabled? (done from lcd menu)
-unsigned char HEATER_State = 0;       // If set, heater relay is turned on
+// TASK PERIODS IN TIMER0 TICKS
+#define TASK_PERIOD_100ms 6 // 16ms * 6 = 96ms
+#define TASK_PERIOD_1s 64
+#define TASK_PERIOD_1min 3662 // 59.998s
 
-// LAMP
-unsigned char LAMP_Enable = 1; // Is lamp enabled (done from lcd menu)
-unsigned char LAMP_State = 1;  // If set, lamp relay is turned on
+// SETTINGS, restored at boot and written behind changes from TASK_Control
+SETTINGS_t SAVED_Settings;
+unsigned char SETTINGS_Restored = 0;
 
-// TODO: Decide on mode change logic
-
-// IF MODE OLD NOT EQUAL NEW THEN MODE CHANGE, BASED ON MODE NEW
-// DEFAULT MODE SITTING
-unsigned char MODE_Old = 0; // 0 FOR SITTING 1 FOR SLEEPING
-// 0 FOR SITTING 1 FOR SLEEPING
-unsigned char MODE_New = 0; // 0 FOR SITTING 1 FOR SLEEPING
-
-// TIMER VARS
-unsigned char TIMER0_Counter = 0;  // counter to help increase the timer interrupt to 100ms
-unsigned char TIMER0_Counter2 = 0; // second counter for 1 sec refresh rate
-unsigned char TIMER0_Counter3 = 0;
-#define TIMER0_Counter_100ms 6 // 16ms * 6 = 96ms
-#define TIMER0_Counter_1s 64
-
-// ON MODE CHANGE TO WAKE UP
-void WAKE_Start(void)
+void SETTINGS_Collect(SETTINGS_t *s)
 {
-  // SERVO FRONT
-  SERVO_On(2);
-  _delay_ms(500);
-  SERVO_Off();
+  s->heater_threshold = BED.heater_threshold;
+  s->heater_enable = BED.heater_enable;
+  s->lamp_enable = BED.lamp_enable;
+  s->lamp_state = BED.lamp_state;
+  s->mode = BED.mode_new;
+  s->cal_zero = LOADCELL_Cal.zero;
+  s->cal_gain = LOADCELL_Cal.gain;
+}
 
-  // LIGHT ON
-  LAMP_State = 1;
+void SETTINGS_Restore(void)
+{
+  SETTINGS_Restored = SETTINGS_Load(&SAVED_Settings);
+  if (SETTINGS_Restored)
+  {
+    BED.heater_threshold = SAVED_Settings.heater_threshold;
+    BED.heater_enable = SAVED_Settings.heater_enable;
+    BED.lamp_enable = SAVED_Settings.lamp_enable;
+    BED.lamp_state = SAVED_Settings.lamp_state;
+    // the bed is still where it was, no posture change
+    BED.mode_new = BED.mode_old = SAVED_Settings.mode;
+    SERVO_SetPosture(BED.mode_new ? SERVO_POSTURE_SLEEP : SERVO_POSTURE_SIT);
+    LOADCELL_Cal_t cal = {SAVED_Settings.cal_zero, SAVED_Settings.cal_gain};
+    LOADCELL_SetCal(&cal);
+  }
+  else
+  {
+    SETTINGS_Collect(&SAVED_Settings);
+  }
+}
 
-  // EQUATE MODES
+void SETTINGS_Sync(void)
+{
+  SETTINGS_t now = SAVED_Settings;
 
-  MODE_Old = MODE_New;
+  SETTINGS_Collect(&now);
+  if (now.heater_threshold != SAVED_Settings.heater_threshold || now.heater_enable != SAVED_Settings.heater_enable ||
+      now.lamp_enable != SAVED_Settings.lamp_enable || now.lamp_state != SAVED_Settings.lamp_state ||
+      now.mode != SAVED_Settings.mode || now.cal_zero != SAVED_Settings.cal_zero ||
+      now.cal_gain != SAVED_Settings.cal_gain)
+  {
+    // retried next second if the EEPROM queue is full
+    if (SETTINGS_Save(&now))
+    {
+      SAVED_Settings = now;
+    }
+  }
 }
 
-void SLEEP_Start(void)
+// TASK EACH TICK: BED EXIT, each new load cell sample (~49ms) goes to the detector
+void TASK_Exit(void)
 {
-  // SERVO LAID BACK
-  SERVO_On(2);
-  _delay_ms(500);
-  SERVO_Off();
-  // LIGHT OFF
-  LAMP_State = 0;
+  static unsigned char seq;
 
-  // EQUATE MODES
-  MODE_Old = MODE_New;
+  if (!ADC_ScanReady() || ADC_OversampleSeq() == seq)
+  {
+    return;
+  }
+  seq = ADC_OversampleSeq();
+  if (BED_Weigh(&BED, LOADCELL_ReadWeight()) != BEDEXIT_EV_NONE)
+  {
+    // sounds now, logged by TASK_Sense
+    ALARM_Set(ALARM_SLOT_EXIT, BED.alarm_exit && ALARM_EN);
+  }
 }
 
-// INTERRUPT FUNCTION EACH 16ms
-ISR(TIMER0_OVF_vect)
+// TASK EACH 100ms: SENSING
+void TASK_Sense(void)
 {
-  TIMER0_Counter++;
-  TIMER0_Counter2++;
-
-  // ENTERS EACH 100ms
-  if (TIMER0_Counter == TIMER0_Counter_100ms)
+  // nothing to decide on before the first complete scan
+  if (!ADC_ScanReady())
   {
-    // START
+    return;
+  }
 
-    // ------------WEIGHT------------------//
-    // Refresh current weight from adc
-    CURRENT_Weight = LOADCELL_ReadWeight() / 3;
-    // Check if max rated weight exceeded
-    if (CURRENT_Weight > MAX_Weight)
-    {
-      ALARM_Weight = 1;
-    }
-    else if (CURRENT_Weight > 10) // if weight within operating range
-    {
-      OCCUPANCY_Time++; // each 100ms
-      ALARM_Weight = 0;
-    }
-    else
-    {
-      OCCUPANCY_Time = 0; // if not used
-      ALARM_Weight = 0;
-    }
+  // load cell zero follows slow drift while the bed is empty
+  LOADCELL_Track();
 
-    //-------------TEMPERATURE-----------//
-    BODY_Temp = (unsigned char)(((ADC_Read(2) * (5.0f / 1024) * 1000)) / 10); //
-    ROOM_Temp = (unsigned char)(((ADC_Read(3) * (5.0f / 1024) * 1000)) / 10); //
+  // integer conversion, no soft float, the bed filters before any decision
+  unsigned char changed = BED_Sense(&BED, LOADCELL_ReadWeight(),
+                                    SENSOR_Convert(&SENSOR_BodyTemp, ADC_ReadLatest(BODY_TEMP_ADC)),
+                                    SENSOR_Convert(&SENSOR_RoomTemp, ADC_ReadLatest(ROOM_TEMP_ADC)));
 
-    if (BODY_Temp > 37)
-    {
-      ALARM_Fever = 1;
-    }
-    else
-    {
-      ALARM_Fever = 0;
-    }
+  //-------------ALARMS----------------//
+  // the annunciator sounds them from the tick
+  ALARM_Set(ALARM_SLOT_WEIGHT, BED.alarm_weight && ALARM_EN);
+  ALARM_Set(ALARM_SLOT_EXIT, BED.alarm_exit && ALARM_EN);
+  ALARM_Set(ALARM_SLOT_FEVER, BED.alarm_fever && ALARM_EN);
 
-    if ((ROOM_Temp < HEATER_Threshold) && HEATER_Enable)
-    {
-      HEATER_State = 1;
-    }
-    else
+  // raises and clears go to the trend log
+  for (unsigned char slot = 0; slot < ALARM_SLOTS; slot++)
+  {
+    if (changed & (1 << slot))
     {
-      HEATER_State = 0;
+      EELOG_Event((BED.alarms & (1 << slot)) ? EELOG_EV_ALARM_ON : EELOG_EV_ALARM_OFF, slot);
+      TLM_Alarm(slot, (BED.alarms >> slot) & 1);
     }
+  }
+
+  //-------------TELEMETRY-------------//
+  TLM_Sample_t sample = {BED.body, BED.room, BED.weight, LOADCELL_ReadRaw(), HEATER_Duty(&BED.heater), 0};
+  if (BED.heater_state)
+  {
+    sample.flags |= TLM_FLAG_HEATER;
+  }
+  if (BED_Lamp(&BED))
+  {
+    sample.flags |= TLM_FLAG_LAMP;
+  }
+  if (BED.alarm_fever)
+  {
+    sample.flags |= TLM_FLAG_FEVER;
+  }
+  if (BED.alarm_weight)
+  {
+    sample.flags |= TLM_FLAG_WEIGHT;
+  }
+  if (BED.alarm_exit)
+  {
+    sample.flags |= TLM_FLAG_EXIT;
+  }
+  TLM_Sample(&sample);
+}
 
-    // END of scope (100ms refresh)
-    TIMER0_Counter = 0;
+// TASK EACH 100ms: HEATER PID AND TIME PROPORTIONED RELAY
+void TASK_Heater(void)
+{
+  if (!ADC_ScanReady())
+  {
+    return;
   }
+  RELAY_Heater(BED_Heater(&BED));
 
-  // START OF 1SEC REFRESH
+  // end of the 100ms cycle, sensing and heater decisions go out together
+  BED_Publish(&BED, &BED_Shared);
+}
 
-  if (TIMER0_Counter2 == TIMER0_Counter_1s)
+// TASK EACH 1s: MODE CHANGES AND OUTPUTS
+void TASK_Control(void)
+{
+  // a mode change moves the bed, the servo runs in the background from the tick
+  switch (BED_Control(&BED))
   {
+  case BED_MOVE_SLEEP:
+    SERVO_Move(SERVO_POSTURE_SLEEP);
+    break;
+  case BED_MOVE_SIT:
+    SERVO_Move(SERVO_POSTURE_SIT);
+    break;
+  }
+  SETTINGS_Sync();
 
-    // If a change in modes occurs the corresponding functions will be called
-    if (MODE_Old != MODE_New)
-    {
-      if (MODE_New == 1)
-      {
-        SLEEP_Start();
-      }
-      if (MODE_New == 0)
-      {
-        WAKE_Start();
-      }
-    }
-    // TEMPERATURE AND LIGHTING OUTPUTS
-    if (HEATER_State == 1 && HEATER_Enable == 1)
-    {
-      RELAY_Heater(ON);
-    }
-    else
-    {
-      RELAY_Heater(OFF);
-    }
+  // TELEMETRY, state on change and the stats record
+  TLM_State_t state = {BED.mode_new, BED.heater_enable, BED.heater_threshold, BED.lamp_enable, BED.lamp_state,
+                       BED.alarms};
+  TLM_State(&state);
+  TLM_Second();
 
-    if (LAMP_State == 1 && LAMP_Enable == 1)
-    {
-      RELAY_Lamp(ON);
-    }
-    else
-    {
-      RELAY_Lamp(OFF);
-    }
-    // 10 second alarm trigger
-    TIMER0_Counter3++;
-    if (TIMER0_Counter3 == 10)
-    {
-      if (ALARM_Fever == 1 && ALARM_EN) // TODO: Add snooze counter
-      {
-        alarm_fever();
-        ALARM_Fever = 0; // RESET ALARM FLAG
-      }
-      if (ALARM_Weight == 1 && ALARM_EN)
-      {
-        alarm_max_weight();
-        ALARM_Weight = 0;
-      }
+  // LIGHTING OUTPUT, the annunciator owns the lamp while an alarm sounds
+  if (!ALARM_Sounding())
+  {
+    RELAY_Lamp(BED_Lamp(&BED) ? ON : OFF);
+  }
+  BED_Publish(&BED, &BED_Shared);
+}
 
-      TIMER0_Counter3 = 0;
-    }
+// TASK EACH MINUTE: TREND RECORD TO EEPROM
+void TASK_Log(void)
+{
+  BED_View_t v;
+  BED_Snapshot(&BED_Shared, &v);
+  EELOG_Trend_t trend = {v.body, v.room, v.weight, v.occupancy};
+  EELOG_Trend(&trend);
+}
+
+// BOOT STEPS, polled each tick by TASK_Boot until done
+unsigned char BOOT_Lcd(void)
+{
+  if (BOOT_Ms() < LCD_POWERUP_MS)
+  {
+    return 0;
+  }
+  LCD_Init();
+  return 1;
+}
+
+unsigned char BOOT_Servo(void)
+{
+  if (BOOT_Ms() < SERVO_SETTLE_MS)
+  {
+    return 0;
+  }
+  SERVO_Start();
+  return 1;
+}
+
+static const char BOOT_T_LCD[] PROGMEM = "lcd";
+static const char BOOT_T_SERVO[] PROGMEM = "srv";
+
+#define BOOT_STEP_LCD 0
+BOOT_Step_t BOOT_STEPS[] = {
+    BOOT_STEP(BOOT_Lcd, BOOT_T_LCD),
+    BOOT_STEP(BOOT_Servo, BOOT_T_SERVO),
+};
+
+// TASK EACH TICK UNTIL BOOTED
+void TASK_Boot(void)
+{
+  BOOT_Run();
+}
+
+void UI_Step(void);
 
-    // END OF 1 SEC SCOPE
-    TIMER0_Counter2 = 0;
+// TASK EACH TICK: menu, alarm banner and a few changed LCD cells
+void TASK_Display(void)
+{
+  static const char *banner = 0;
+  const char *msg = ALARM_Message();
+
+  UI_Step(); // nothing until MENU_Init
+
+  if (msg != banner)
+  {
+    banner = msg;
+    lcd_setbanner(msg);
   }
+  LCD_Flush();
+}
+
+// TASK TABLE (periods in 16ms ticks, phases spread the work over different ticks)
+SCHED_Task_t TASKS[] = {
+    SCHED_TASK(TASK_Exit, 1, 0, 0),
+    SCHED_TASK(TASK_Sense, TASK_PERIOD_100ms, 0, 1),
+    SCHED_TASK(TASK_Heater, TASK_PERIOD_100ms, 3, 2),
+    SCHED_TASK(TASK_Control, TASK_PERIOD_1s, 3, 3),
+    SCHED_TASK(TASK_Display, 1, 0, 4),
+    SCHED_TASK(TASK_Log, TASK_PERIOD_1min, TASK_PERIOD_1min, 5),
+    SCHED_TASK(TASK_Boot, 1, 0, 6),
+};
+
+// INTERRUPT FUNCTION EACH 16ms, ONLY RELEASES TASKS
+ISR(TIMER0_OVF_vect)
+{
+  PROF_TICK();
+  PROF_ENTER();
+  TIMER0_Ticks++;
+  PUSHBUTTONS_Tick();
+  ADC_Tick();
+  SERVO_Tick();
+  ALARM_Tick();
+  SCHED_Tick();
+  PROF_EXIT(PROF_ISR_TIMER0);
 }
 
 #define DEBUGMODE 0
@@ -202,373 +307,422 @@ int main(void)
 {
   unsigned char buttonpressed;
 
+  BED_Init(&BED);
   ADC_Init();
+  TIMER1_Init();
+  SCHED_Init(TASKS, sizeof(TASKS) / sizeof(TASKS[0]));
   TIMER0_Init();
+  ADC_ScanStart(ADC_SCAN_Channels, sizeof(ADC_SCAN_Channels));
   LOADCELL_Init();
   PUSHBUTTONS_Init();
   LCD_Init();
   RELAY_Init();
 
   // dont forget to enable these when debugging because the ISR wont allow RELAY_Lamp enable without them
-  // LAMP_State = 1;
-  LAMP_Enable = 1;
+  // BED.lamp_state = 1;
+  BED.lamp_enable = 1;
 
-  HEATER_Enable = 1;
-  // HEATER_State = 1;
+  BED.heater_enable = 1;
+  // BED.heater_state = 1;
   lcd_send_number(58);
-  _delay_ms(200);
-  LCD_SendCommand(1);
+  SCHED_Delay_ms(200);
+  lcd_clear();
   lcd_send_number(148);
-  _delay_ms(200);
-  LCD_SendCommand(1);
+  SCHED_Delay_ms(200);
+  lcd_clear();
   lcd_send_number(5);
-  _delay_ms(200);
-  LCD_SendCommand(1);
+  SCHED_Delay_ms(200);
+  lcd_clear();
 
   while (1)
   {
     lcd_send_number(58);
-    _delay_ms(500);
-    LCD_SendCommand(1);
+    SCHED_Delay_ms(500);
+    lcd_clear();
 
     lcd_send_number(148);
-    _delay_ms(500);
-    LCD_SendCommand(1);
+    SCHED_Delay_ms(500);
+    lcd_clear();
 
     lcd_send_number(5);
-    _delay_ms(500);
-    LCD_SendCommand(1);
+    SCHED_Delay_ms(500);
+    lcd_clear();
   }
 
   return 0;
 }
 
-#else
+// no menu in debug mode
+void UI_Step(void)
+{
+}
 
-unsigned char key, c, tt; // define variables key for pushed button//c for counting
+#else
 
-void alarm_fever(void)
+#define DIAG_KEY 3 // hold LEFT for the hidden diagnostics pages
+#define DIAG_PAGES (PROF_REGIONS + 2) // profiler regions, then boot times and sleep residency
+
+// MENU NODES
+#define UI_WELCOME 0
+#define UI_LOGIN 1
+#define UI_PASSWORD 2
+#define UI_WRONG 3
+#define UI_BYE 4
+#define UI_HOME 5
+#define UI_SLEEPING 6
+#define UI_BODY 7
+#define UI_ROOM 8
+#define UI_WEIGHT 9
+#define UI_OCCUPANCY 10
+#define UI_SITTING 11
+#define UI_OPTIONS 12
+#define UI_HEATING 13
+#define UI_HEATER_ON 14
+#define UI_HEAT_TEMP 15
+#define UI_HEATER_OFF 16
+#define UI_LAMP 17
+#define UI_LAMP_ON 18
+#define UI_LAMP_OFF 19
+#define UI_DIAG 20
+#define UI_SCALE 21
+#define UI_TARE 22
+#define UI_TARED 23
+#define UI_SPAN 24
+#define UI_CAL_OK 25
+#define UI_CAL_BAD 26
+
+#define UI_PASS 1111 // four presses of key 1
+#define UI_SPAN_KG 70 // first known load offered for the span
+
+// MENU ICONS, 5x8 CGRAM patterns
+#define UI_G_THERMO "\1"
+#define UI_G_FLAME "\2"
+#define UI_G_LAMP "\3"
+
+static const u8 UI_GLYPHS[][8] PROGMEM = {
+    {0x04, 0x0a, 0x0a, 0x0a, 0x0e, 0x1f, 0x1f, 0x0e}, // thermometer
+    {0x04, 0x04, 0x0a, 0x0a, 0x15, 0x11, 0x11, 0x0e}, // flame
+    {0x0e, 0x11, 0x11, 0x11, 0x0a, 0x0e, 0x0e, 0x04}, // bulb
+};
+
+// MENU TEXT
+static const char UI_T_WELCOME[] PROGMEM = "    WELCOME!";
+static const char UI_T_LOGIN[] PROGMEM = "   For Login\n  Press :  1";
+static const char UI_T_PASSWORD[] PROGMEM = " USER : Hassan\nPASS : %";
+static const char UI_T_WRONG[] PROGMEM = " wrong pass\n    try again";
+static const char UI_T_BYE[] PROGMEM = " good bye";
+static const char UI_T_HOME[] PROGMEM = " 1:for sleep mode\n 2:for sit mode";
+static const char UI_T_SLEEPING[] PROGMEM = " sleeping..";
+static const char UI_T_BODY[] PROGMEM = UI_G_THERMO "body temp:%\n1:roomtmp 2:home";
+static const char UI_T_ROOM[] PROGMEM = UI_G_THERMO "room temp:%\n 1:weight 2:home";
+static const char UI_T_WEIGHT[] PROGMEM = " weight:%\n1:occ time2:home";
+static const char UI_T_OCCUPANCY[] PROGMEM = " occupy time:%\n 2:home";
+static const char UI_T_SITTING[] PROGMEM = " sitting..";
+static const char UI_T_OPTIONS[] PROGMEM = " options\n 1:next 2:home";
+static const char UI_T_HEATING[] PROGMEM = UI_G_FLAME "heating\n 1:on 2:off";
+static const char UI_T_HEATER_ON[] PROGMEM = "heater on";
+static const char UI_T_HEAT_TEMP[] PROGMEM = UI_G_FLAME "heat temp\n put temp:%";
+static const char UI_T_HEATER_OFF[] PROGMEM = "heater off";
+static const char UI_T_LAMP[] PROGMEM = UI_G_LAMP "lamp enable\n 1:on  2:off";
+static const char UI_T_LAMP_ON[] PROGMEM = "lamp on";
+static const char UI_T_LAMP_OFF[] PROGMEM = "lamp off";
+static const char UI_T_SCALE[] PROGMEM = " scale\n 1:home 2:calib";
+static const char UI_T_TARE[] PROGMEM = " empty the bed\n 1:tare 2:home";
+static const char UI_T_TARED[] PROGMEM = " zero set";
+static const char UI_T_SPAN[] PROGMEM = " span load:";
+static const char UI_T_SPAN_KEYS[] PROGMEM = "1+ 2- 3:end 4:ok";
+static const char UI_T_CAL_OK[] PROGMEM = " scale set";
+static const char UI_T_CAL_BAD[] PROGMEM = " span refused\n load too light";
+
+// MENU ACTIONS, run on a key before the menu moves
+u8 UI_Password(u8 key, u16 number)
 {
-  LCD_SendCommand(1);
-  lcd_sendstring("HIGH FEVER!");
-  _delay_ms(200);
-  BUZZER_Pulse_ms(500);
-  LCD_SendCommand(1);
+  return number == UI_PASS ? UI_HOME : UI_WRONG;
 }
-void alarm_max_weight(void)
-{
 
-  LCD_SendCommand(1);
-  lcd_sendstring("MAX WEIGHT");
-  _delay_ms(200);
-  BUZZER_Pulse_ms(500);
-  LCD_SendCommand(1);
+u8 UI_Mode(u8 key, u16 number)
+{
+  BED.mode_new = key == 1; // the bed moves from TASK_Control
+  return MENU_NEXT;
 }
-// frame 1 in sleep mode LOADING
-void sleep1(void)
+
+u8 UI_Heater(u8 key, u16 number)
 {
+  BED.heater_enable = key == 1;
+  return MENU_NEXT;
+}
 
-  lcd_sendstring(" sleeping..");
-  _delay_ms(2000);
-  LCD_SendCommand(1);
-  lcd_sendstring(" body temp:");
-  lcd_send_number(BODY_Temp);
-  lcd_setcursor(1, 0);
-  lcd_sendstring("1:roomtmp ");
-  lcd_sendstring("2:home ");
+u8 UI_HeatTemp(u8 key, u16 number)
+{
+  BED.heater_threshold = number;
+  return MENU_NEXT;
 }
-// frame 2 in sleep mode ROOM TEMPERATURE
-void sleep2(void)
+
+u8 UI_Lamp(u8 key, u16 number)
 {
-  // TODO: keep checking on ROOM_Temp variable
-  LCD_SendCommand(1);
-  lcd_sendstring(" room temp:");
-  lcd_send_number(ROOM_Temp);
-  lcd_setcursor(1, 0);
-  lcd_sendstring(" 1:weight");
-  lcd_sendstring(" 2:home ");
+  BED.lamp_enable = BED.lamp_state = key == 1;
+  return MENU_NEXT;
 }
-// frame 3 in sleep mode  CURENT WEIGHT
-void sleep3(void)
+
+u8 UI_Tare(u8 key, u16 number)
 {
-  // TODO: keep checking on CURRENT_Weight variable
-  LCD_SendCommand(1);
-  lcd_sendstring(" weight:");
-  lcd_send_number(CURRENT_Weight);
-  lcd_setcursor(1, 0);
-  lcd_sendstring("1:occ time");
-  lcd_sendstring("2:home ");
+  if (key == 1)
+  {
+    LOADCELL_Tare(); // saved by TASK_Control with the settings
+  }
+  return MENU_NEXT;
 }
-void sleep4(void) // frame 4 in sleep mode SLEEP TIME (should be occupancy)
+
+// known load on the bed, UP/DOWN change it (held they repeat), RIGHT takes the span, LEFT leaves
+u8 UI_SpanLoad(u8 key, u16 number)
 {
-  // TODO: keep checking on OCCUPANCY_Time variable
-  LCD_SendCommand(1);
-  lcd_sendstring(" occupy time:");
-  lcd_send_number(OCCUPANCY_Time);
+  static unsigned short kg = UI_SPAN_KG;
+
+  if (key == 1 && kg < 999)
+  {
+    kg++;
+  }
+  else if (key == 2 && kg > 1)
+  {
+    kg--;
+  }
+  else if (key == 3)
+  {
+    return UI_HOME; // the zero stays, the gain too
+  }
+  else if (key == 4)
+  {
+    return LOADCELL_Span(kg) ? UI_CAL_OK : UI_CAL_BAD;
+  }
+  lcd_clear();
+  lcd_sendstring_P(UI_T_SPAN);
+  lcd_send_number(kg);
+  lcd_sendstring_P(PSTR("kg"));
   lcd_setcursor(1, 0);
-  lcd_sendstring(" 2:home ");
+  lcd_sendstring_P(UI_T_SPAN_KEYS);
+  return MENU_STAY;
 }
-void sit1(void) // frame 1 in sitting mode HOME MENU
+
+// profiler pages, UP/DOWN to step through the regions, LEFT to leave
+u8 UI_Diagnostics(u8 key, u16 number)
 {
-  LCD_SendCommand(1);
-  lcd_sendstring(" sitting..");
+  static unsigned char page;
 
-  _delay_ms(2000);
-  LCD_SendCommand(1);
-  lcd_sendstring(" options");
-  lcd_setcursor(1, 0);
-  lcd_sendstring(" 1:next");
-  lcd_sendstring(" 2:home ");
+  if (key == 0)
+  {
+    page = 0;
+  }
+  else if (key == 1)
+  {
+    page = (page + 1) % DIAG_PAGES;
+  }
+  else if (key == 2)
+  {
+    page = page ? page - 1 : DIAG_PAGES - 1;
+  }
+  else if (key == DIAG_KEY)
+  {
+    return MENU_BACK;
+  }
+  if (page < PROF_REGIONS)
+  {
+    PROF_ShowPage(page);
+  }
+  else if (page == PROF_REGIONS)
+  {
+    BOOT_ShowPage();
+  }
+  else
+  {
+    PWR_ShowPage();
+  }
+  return MENU_STAY;
 }
-void sit2(void) // frame 2 in sitting mode HEATER ENABLE/DISABLE
+
+// LIVE FIELDS, from the published bed state
+u16 UI_Body(void)
 {
-  LCD_SendCommand(1);
-  lcd_sendstring(" heating");
-  lcd_setcursor(1, 0);
-  lcd_sendstring(" 1:on");
-  lcd_sendstring(" 2:off ");
+  BED_View_t v;
+  BED_Snapshot(&BED_Shared, &v);
+  return v.body;
 }
-void sit3(void) // frame 3 in sitting mode HEATER ON SELECT TEMP
+
+u16 UI_Room(void)
 {
-  c = 0;
-  LCD_SendCommand(1);
-  lcd_sendstring(" heat temp");
-  lcd_setcursor(1, 0);
-  lcd_sendstring(" put temp:");
+  BED_View_t v;
+  BED_Snapshot(&BED_Shared, &v);
+  return v.room;
+}
+
+u16 UI_Weight(void)
+{
+  BED_View_t v;
+  BED_Snapshot(&BED_Shared, &v);
+  return v.weight;
 }
-void sit4() // frame 4 in sitting mode LAMP ENABLE
+
+u16 UI_Occupancy(void)
 {
-  LCD_SendCommand(1);
-  lcd_sendstring(" lamp enable");
-  lcd_setcursor(1, 0);
-  lcd_sendstring(" 1:on");
-  lcd_sendstring("  2:off ");
+  BED_View_t v;
+  BED_Snapshot(&BED_Shared, &v);
+  return v.occupancy;
 }
 
-unsigned char choose(void) // polling function to w8 user to press key
+// MENU GRAPH (text, kind, arg, key 1, key 2, action, field)
+static const MENU_Node_t UI_NODES[] PROGMEM = {
+    MENU_NODE(UI_T_WELCOME, MENU_MESSAGE, MENU_MS(300), UI_LOGIN, 0, 0, 0),
+    MENU_NODE(UI_T_LOGIN, MENU_PAGE, 0, UI_PASSWORD, UI_BYE, 0, 0),
+    MENU_NODE(UI_T_PASSWORD, MENU_DIGITS, 4, UI_HOME, 0, UI_Password, 0),
+    MENU_NODE(UI_T_WRONG, MENU_MESSAGE, MENU_MS(200), UI_PASSWORD, 0, 0, 0),
+    MENU_NODE(UI_T_BYE, MENU_MESSAGE, MENU_MS(200), MENU_OFF, 0, 0, 0),
+    MENU_NODE(UI_T_HOME, MENU_PAGE, 0, UI_SLEEPING, UI_SITTING, UI_Mode, 0),
+    MENU_NODE(UI_T_SLEEPING, MENU_MESSAGE, MENU_MS(2000), UI_BODY, 0, 0, 0),
+    MENU_NODE(UI_T_BODY, MENU_VALUE, MENU_FMT_TEMP, UI_ROOM, UI_HOME, 0, UI_Body),
+    MENU_NODE(UI_T_ROOM, MENU_VALUE, MENU_FMT_TEMP, UI_WEIGHT, UI_HOME, 0, UI_Room),
+    MENU_NODE(UI_T_WEIGHT, MENU_VALUE, MENU_FMT_NUMBER, UI_OCCUPANCY, UI_HOME, 0, UI_Weight),
+    MENU_NODE(UI_T_OCCUPANCY, MENU_VALUE, MENU_FMT_NUMBER, MENU_STAY, UI_HOME, 0, UI_Occupancy),
+    MENU_NODE(UI_T_SITTING, MENU_MESSAGE, MENU_MS(2000), UI_OPTIONS, 0, 0, 0),
+    MENU_NODE(UI_T_OPTIONS, MENU_PAGE, 0, UI_HEATING, UI_HOME, 0, 0),
+    MENU_NODE(UI_T_HEATING, MENU_PAGE, 0, UI_HEATER_ON, UI_HEATER_OFF, UI_Heater, 0),
+    MENU_NODE(UI_T_HEATER_ON, MENU_MESSAGE, MENU_MS(200), UI_HEAT_TEMP, 0, 0, 0),
+    MENU_NODE(UI_T_HEAT_TEMP, MENU_DIGITS, 2, UI_LAMP, 0, UI_HeatTemp, 0),
+    MENU_NODE(UI_T_HEATER_OFF, MENU_MESSAGE, MENU_MS(200), UI_LAMP, 0, 0, 0),
+    MENU_NODE(UI_T_LAMP, MENU_PAGE, 0, UI_LAMP_ON, UI_LAMP_OFF, UI_Lamp, 0),
+    MENU_NODE(UI_T_LAMP_ON, MENU_MESSAGE, MENU_MS(200), UI_SCALE, 0, 0, 0),
+    MENU_NODE(UI_T_LAMP_OFF, MENU_MESSAGE, MENU_MS(200), UI_SCALE, 0, 0, 0),
+    MENU_NODE(0, MENU_CUSTOM, 0, 0, 0, UI_Diagnostics, 0),
+    MENU_NODE(UI_T_SCALE, MENU_PAGE, 0, UI_HOME, UI_TARE, 0, 0),
+    MENU_NODE(UI_T_TARE, MENU_PAGE, 0, UI_TARED, UI_HOME, UI_Tare, 0),
+    MENU_NODE(UI_T_TARED, MENU_MESSAGE, MENU_MS(1000), UI_SPAN, 0, 0, 0),
+    MENU_NODE(0, MENU_CUSTOM, MENU_REPEAT, 0, 0, UI_SpanLoad, 0),
+    MENU_NODE(UI_T_CAL_OK, MENU_MESSAGE, MENU_MS(2000), UI_HOME, 0, 0, 0),
+    MENU_NODE(UI_T_CAL_BAD, MENU_MESSAGE, MENU_MS(2000), UI_SPAN, 0, 0, 0),
+};
+
+// one button event into the menu, the menu never waits
+void UI_Step(void)
 {
-  do
+  static unsigned char diag_held = 0;
+  static unsigned char alarm_key = 0; // key that snoozed or acknowledged, ignored until released
+  unsigned char ev;
+
+  MENU_Poll();
+  if (!MENU_Input())
   {
+    return; // keys stay queued while a message shows
+  }
+  BOOT_UiReady();
 
-    key = PUSHBUTTONS_Read();
+  ev = PUSHBUTTONS_GetEvent();
 
-  } while (key == 0xff);
-  return key;
+  // the rest of a press used on the alarm never reaches the menu
+  if (ev && PUSHBUTTONS_EV_KEY(ev) == alarm_key)
+  {
+    if (PUSHBUTTONS_EV_TYPE(ev) == PUSHBUTTONS_EV_RELEASE)
+    {
+      alarm_key = 0;
+    }
+    ev = 0;
+  }
+
+  // while an alarm sounds a press only snoozes it, holding UP acknowledges
+  if (PUSHBUTTONS_EV_TYPE(ev) == PUSHBUTTONS_EV_PRESS && ALARM_Sounding())
+  {
+    ALARM_Snooze();
+    alarm_key = PUSHBUTTONS_EV_KEY(ev);
+    ev = 0;
+  }
+  else if (ev == (PUSHBUTTONS_EV_LONG | 1) && ALARM_Active())
+  {
+    ALARM_Acknowledge();
+    alarm_key = 1;
+    ev = 0;
+  }
+
+  // the diagnostics key counts on release, unless it was held
+  if (PUSHBUTTONS_EV_KEY(ev) == DIAG_KEY)
+  {
+    if (ev == (PUSHBUTTONS_EV_LONG | DIAG_KEY))
+    {
+      diag_held = 1;
+      MENU_Call(UI_DIAG);
+      ev = 0;
+    }
+    else if (ev == (PUSHBUTTONS_EV_RELEASE | DIAG_KEY))
+    {
+      ev = diag_held ? 0 : (PUSHBUTTONS_EV_PRESS | DIAG_KEY);
+      diag_held = 0;
+    }
+    else
+    {
+      ev = 0;
+    }
+  }
+
+  if (PUSHBUTTONS_EV_TYPE(ev) == PUSHBUTTONS_EV_PRESS)
+  {
+    MENU_Key(PUSHBUTTONS_EV_KEY(ev));
+  }
+  else if (PUSHBUTTONS_EV_TYPE(ev) == PUSHBUTTONS_EV_REPEAT)
+  {
+    MENU_Repeat(PUSHBUTTONS_EV_KEY(ev));
+  }
 }
+
 int main(void)
 {
+  // reset cause, a watchdog reset leaves the watchdog running
+  BOOT_ResetFlags = MCUSR;
+  MCUSR = 0;
+  WDTCSR |= (1 << 4) | (1 << 3); // WDCE, WDE
+  WDTCSR = 0;
+
+  // CONTROL LOOP FIRST: outputs off, settings, sensing, heater, alarms
+  BED_Init(&BED);
+  RELAY_Init();
+  BUZZER_Init();
+  SERVO_Init();
+  EEPROM_Init();
+  SETTINGS_Restore();
+  BED_Publish(&BED, &BED_Shared);
   ADC_Init();
+  TIMER1_Init();
+  SCHED_Init(TASKS, sizeof(TASKS) / sizeof(TASKS[0]));
+  ALARM_Init();
   TIMER0_Init();
+  ADC_ScanStart(ADC_SCAN_Channels, sizeof(ADC_SCAN_Channels));
   LOADCELL_Init();
   PUSHBUTTONS_Init();
-  LCD_Init();
-  RELAY_Init();
-  SERVO_Init();
-  BUZZER_Init();
+  EELOG_Init();
+  EELOG_Event(EELOG_EV_BOOT, BOOT_ResetFlags);
+  TLM_Init();
 
-  unsigned char mode = 5, Pass = 0, ff = 0;
-  lcd_setcursor(0, 4);
-  lcd_sendstring("WELCOME!");
-  _delay_ms(300);
-  LCD_SendCommand(1);
-  lcd_setcursor(0, 10);
-  lcd_sendstring(" For Login");
-  lcd_setcursor(1, 2);
-  lcd_sendstring("Press :  1");
-  key = choose(); // wait to check pressed button from the user
-  if (key == 1)
+  // LCD and servo come up in the background from TASK_Boot
+  BOOT_Init(BOOT_STEPS, sizeof(BOOT_STEPS) / sizeof(BOOT_STEPS[0]));
+  while (!BOOT_StepDone(BOOT_STEP_LCD))
   {
-    LCD_SendCommand(1);
-    while (Pass != 4) // will be in the loop while the password is not correct
+    if (!SCHED_Dispatch())
     {
-      ff = 0;
-      LCD_SendCommand(1);
-      lcd_sendstring(" USER : Hassan");
-      lcd_setcursor(1, 0);
-      lcd_sendstring("PASS : ");
-      while (ff != 4) // make password from 4 digit
-      {
-        key = choose();
-        LCD_SendData(key + '0'); // to recive correct number in ascii code
-        Pass += key;
-        ff++;
-        if (ff == 4)
-          _delay_ms(200);
-      }
-      ff = 0;
-      if (Pass != 4)
-      {
-        Pass = 0;
-        LCD_SendCommand(1);
-        lcd_sendstring(" wrong pass");
-        lcd_setcursor(1, 3);
-        lcd_sendstring(" try again");
-        _delay_ms(200);
-      }
+      HAL_Idle();
     }
-    LCD_SendCommand(1);
-    mode = 5;
   }
 
-  else // if user does not want to login so end the program
+  // after a brownout or watchdog reset the restored session goes on without login
+  if (SETTINGS_Restored && (BOOT_ResetFlags & ((1 << 2) | (1 << 3)))) // BORF, WDRF
   {
-    LCD_SendCommand(1);
-    mode = 4;
-    lcd_sendstring(" good bye");
-    _delay_ms(200);
-    LCD_SendCommand(1);
+    MENU_Init(UI_NODES, UI_GLYPHS, UI_HOME);
+  }
+  else
+  {
+    MENU_Init(UI_NODES, UI_GLYPHS, UI_WELCOME);
   }
-  // _delay_ms(200);//////////////////////////////////////
-
-  // LCD_Print("hello");
-  //_delay_ms(200);
-  // LCD_SendCommand(1);
-  // _delay_ms(200);
 
-  while (mode == 5) // main function after user is allowed in
+  // the menu runs from TASK_Display
+  while (1)
   {
-    LCD_SendCommand(1); // make user choose between 2 modes we have in our program
-    lcd_sendstring(" 1:for sleep mode");
-    lcd_setcursor(1, 0);
-    lcd_sendstring(" 2:for sit mode");
-    mode = choose();
-    LCD_SendCommand(1);
-    if (mode == 1) // if user choose sleep mode
+    if (!SCHED_Dispatch())
     {
-      MODE_New = 1;
-      sleep1();
-      mode = choose();
-      if (mode == 1) // user decides to proceed 1
-      {
-        sleep2();
-        mode = choose();
-
-        if (mode == 1) // user decides to proceed 2
-        {
-          sleep3();
-          mode = choose();
-          if (mode == 1) // user decides to proceed 3
-          {
-            sleep4();
-            mode = choose();
-            if (mode == 2) // user want to return home 3
-            {
-              mode = 5;
-            }
-          }
-          else if (mode == 2) // user want to return home 2
-          {
-            mode = 5;
-          }
-        }
-
-        else if (mode == 2) // user want to return home 1
-        {
-
-          mode = 5;
-        }
-      }
-
-      else if (mode == 2) // if user choose home 0
-      {
-        mode = 5;
-      }
-    }
-    else if (mode == 2) // user choose sitting mode
-    {                   // last if condition
-      MODE_New = 0;     // enable sitting globally (will be read by interrupt)
-      sit1();
-      mode = choose();
-      if (mode == 1) // user want to proceed 1
-      {
-
-        sit2();
-        mode = choose();
-        if (mode == 1) // user want to proceed 2
-        {
-          HEATER_Enable = 1;
-          LCD_SendCommand(1);
-          lcd_sendstring("heater on");
-          _delay_ms(200);
-          LCD_SendCommand(1);
-          sit3();
-          while (c != 2) // wait user to set temp then proceed auto to next step so here user has no option to return home
-          {
-            key = choose();
-            LCD_SendData(key + '0');
-            HEATER_Threshold = 0;
-            if (c == 0)
-            {
-              HEATER_Threshold = key * 10;
-              tt = (key + '0') * 10;
-            }
-            _delay_ms(200);
-            if (c == 1)
-            {
-              HEATER_Threshold += key;
-              tt += (key + '0');
-            }
-            c++;
-            if (c == 2)
-            {
-              _delay_ms(100);
-            }
-          }
-          sit4(); // proceed to final frame in sitting mode
-          mode = choose();
-          if (mode == 1)
-          {
-            LAMP_Enable = 1;
-            LAMP_State = 1;
-            LCD_SendCommand(1);
-            mode = 5; // make mode 5 to return home after outing from this function
-            lcd_sendstring("lamp on");
-            _delay_ms(200);
-          }
-          else if (mode == 2)
-          {
-            LAMP_Enable = 0;
-            LAMP_State = 0;
-            LCD_SendCommand(1);
-            mode = 5; // make mode 5 to return home after outing from this function
-            lcd_sendstring("lamp off");
-
-            _delay_ms(200);
-          }
-        }
-        else if (mode == 2)
-        {
-          HEATER_Enable = 0;
-          LCD_SendCommand(1);
-          lcd_sendstring("heater off");
-          _delay_ms(200);
-          LCD_SendCommand(1);
-          sit4(); // proceed to final frame in sitting mode
-          mode = choose();
-          if (mode == 1)
-          {
-            LAMP_Enable = 1;
-            LAMP_State = 1;
-            LCD_SendCommand(1);
-            mode = 5; // make mode 5 to return home after outing from this function
-            lcd_sendstring("lamp on");
-            _delay_ms(200);
-          }
-          else if (mode == 2)
-          {
-            LAMP_Enable = 0;
-            LAMP_State = 0;
-            LCD_SendCommand(1);
-            mode = 5; // make mode 5 to return home after outing from this function
-            lcd_sendstring("lamp off");
-            _delay_ms(200);
-          }
-        }
-      }
-      else if (mode == 2)
-      {
-        mode = 5;
-      }
+      HAL_Idle();
     }
   }
 }
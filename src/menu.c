@@ -0,0 +1,213 @@
+#include "menu.h"
+#include "lcd.h"
+#include "timer.h"
+
+static const MENU_Node_t *MENU_Nodes;
+static const u8 (*MENU_Glyphs)[8];  // icon n is MENU_Glyphs[n - 1]
+static u8 MENU_Cur = MENU_OFF;
+static u8 MENU_Return = MENU_OFF;
+static u8 MENU_Pending = MENU_STAY; // node to show when MENU_Deadline passes
+static u16 MENU_Deadline;           // timer0 ticks, low 16 bits
+static u8 MENU_FieldRow, MENU_FieldCol;
+static u8 MENU_Count;               // digits entered
+static u16 MENU_Number;
+static u16 MENU_Shown;              // value in the field
+static u8 MENU_ValueWait;           // ticks to the next read
+
+#define MENU_FIELD(f) pgm_read_byte(&MENU_Nodes[MENU_Cur].f)
+
+static void MENU_After(u16 ms, u8 node)
+{
+    // 16.384ms per tick, ticks = ms * 125 / 2048
+    MENU_Deadline = (u16)TIMER0_GetTicks() + (u16)(((unsigned long)ms * 125) >> 11);
+    MENU_Pending = node;
+}
+
+static void MENU_ShowValue(u16 v)
+{
+    lcd_setcursor(MENU_FieldRow, MENU_FieldCol);
+    if (MENU_FIELD(arg) == MENU_FMT_TEMP)
+    {
+        lcd_send_fixed((s16)v, 1);
+    }
+    else
+    {
+        lcd_send_number(v);
+    }
+    // a shorter value leaves no old digits, clipped at the end of the row
+    lcd_sendstring_P(PSTR("   "));
+    MENU_Shown = v;
+}
+
+static void MENU_Draw(void)
+{
+    const char *p = pgm_read_ptr(&MENU_Nodes[MENU_Cur].text);
+    u8 row = 0, col = 0;
+    char ch;
+
+    lcd_clear();
+    if (!p)
+    {
+        return; // custom nodes draw themselves
+    }
+    while ((ch = pgm_read_byte(p++)) != '\0')
+    {
+        if (ch == '\n')
+        {
+            row++;
+            col = 0;
+            lcd_setcursor(row, 0);
+        }
+        else if ((u8)ch < 8)
+        {
+            lcd_sendglyph_P(MENU_Glyphs[ch - 1]);
+            col++;
+        }
+        else if (ch == '%')
+        {
+            MENU_FieldRow = row;
+            MENU_FieldCol = col;
+        }
+        else
+        {
+            lcd_sendchar(ch);
+            col++;
+        }
+    }
+}
+
+void MENU_Goto(u8 node)
+{
+    u8 kind;
+
+    if (node == MENU_STAY)
+    {
+        return;
+    }
+    if (node == MENU_BACK)
+    {
+        node = MENU_Return;
+    }
+    MENU_Cur = node;
+    MENU_Pending = MENU_STAY;
+    if (node == MENU_OFF)
+    {
+        lcd_clear();
+        return;
+    }
+
+    MENU_Draw();
+    MENU_Count = 0;
+    MENU_Number = 0;
+    kind = MENU_FIELD(kind);
+    if (kind == MENU_VALUE)
+    {
+        MENU_ShowValue(((MENU_Value_fn)pgm_read_ptr(&MENU_Nodes[node].value))());
+    }
+    else if (kind == MENU_MESSAGE)
+    {
+        MENU_After(MENU_FIELD(arg) * 100, MENU_FIELD(next[0]));
+    }
+    else if (kind == MENU_CUSTOM)
+    {
+        ((MENU_Action_fn)pgm_read_ptr(&MENU_Nodes[node].action))(0, 0);
+    }
+}
+
+void MENU_Init(const MENU_Node_t *nodes, const u8 (*glyphs)[8], u8 node)
+{
+    MENU_Nodes = nodes;
+    MENU_Glyphs = glyphs;
+    MENU_Goto(node);
+}
+
+void MENU_Call(u8 node)
+{
+    // called again from the node itself: keep the way back
+    if (node != MENU_Cur)
+    {
+        MENU_Return = MENU_Cur;
+    }
+    MENU_Goto(node);
+}
+
+u8 MENU_Input(void)
+{
+    return MENU_Cur != MENU_OFF && MENU_Pending == MENU_STAY && MENU_FIELD(kind) != MENU_MESSAGE;
+}
+
+void MENU_Key(u8 key)
+{
+    MENU_Action_fn action;
+    u8 kind, next = MENU_STAY;
+
+    if (!MENU_Input())
+    {
+        return;
+    }
+    kind = MENU_FIELD(kind);
+    action = (MENU_Action_fn)pgm_read_ptr(&MENU_Nodes[MENU_Cur].action);
+
+    if (kind == MENU_DIGITS)
+    {
+        lcd_setcursor(MENU_FieldRow, MENU_FieldCol + MENU_Count);
+        lcd_sendchar('0' + key);
+        MENU_Number = MENU_Number * 10 + key;
+        if (++MENU_Count < MENU_FIELD(arg))
+        {
+            return;
+        }
+        next = action ? action(key, MENU_Number) : MENU_NEXT;
+        MENU_After(MENU_HOLD_MS, next == MENU_NEXT ? MENU_FIELD(next[0]) : next);
+        return;
+    }
+
+    if (kind == MENU_CUSTOM)
+    {
+        MENU_Goto(action(key, 0));
+        return;
+    }
+
+    // pages, keys 3 and 4 have no meaning there
+    if (key == 1 || key == 2)
+    {
+        next = action ? action(key, 0) : MENU_NEXT;
+        MENU_Goto(next == MENU_NEXT ? MENU_FIELD(next[key - 1]) : next);
+    }
+}
+
+void MENU_Repeat(u8 key)
+{
+    // pages, digits and messages wait for a new press
+    if (MENU_Input() && MENU_FIELD(kind) == MENU_CUSTOM && MENU_FIELD(arg) == MENU_REPEAT)
+    {
+        MENU_Key(key);
+    }
+}
+
+void MENU_Poll(void)
+{
+    u16 v;
+
+    if (MENU_Cur == MENU_OFF)
+    {
+        return;
+    }
+    if (MENU_Pending != MENU_STAY)
+    {
+        if ((s16)(MENU_Deadline - (u16)TIMER0_GetTicks()) <= 0)
+        {
+            MENU_Goto(MENU_Pending);
+        }
+        return;
+    }
+    if (MENU_FIELD(kind) == MENU_VALUE && ++MENU_ValueWait >= MENU_VALUE_TICKS)
+    {
+        MENU_ValueWait = 0;
+        v = ((MENU_Value_fn)pgm_read_ptr(&MENU_Nodes[MENU_Cur].value))();
+        if (v != MENU_Shown)
+        {
+            MENU_ShowValue(v);
+        }
+    }
+}
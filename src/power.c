@@ -0,0 +1,92 @@
+#include "power.h"
+#include "hal.h"
+#include "ADC.h"
+#include "uart.h"
+#include "servo.h"
+#include "timer.h"
+#include "lcd.h"
+#include "scheduler.h"
+
+PWR_Residency_t PWR_Residency[PWR_MODES];
+
+#if HAL_SLEEP_STOPS_IO
+static u8 PWR_T0Eighths = 0; // timer0 counts owed, in 1/8
+#endif
+
+void PWR_Idle(void)
+{
+    u8 mode = PWR_MODE_IDLE;
+    u16 start, counts;
+    PWR_Residency_t *r;
+
+    cli();
+    // a tick released a task since the dispatcher looked, sleeping would hold it for a tick
+    if (SCHED_Pending())
+    {
+        sei();
+        return;
+    }
+    if (ADC_TakeDue())
+    {
+        // nothing may need clkIO while it is stopped
+        if (UART_Idle() && SERVO_Status() == SERVO_IDLE)
+        {
+            mode = PWR_MODE_ADCNR; // entering the mode starts the conversion
+        }
+        else
+        {
+            ADC_Convert();
+        }
+    }
+    start = TIMER1_Now();
+    HAL_Sleep(mode); // interrupts on, back after the ISR that woke us
+    counts = TIMER1_Now() - start;
+
+#if HAL_SLEEP_STOPS_IO
+    if (mode == PWR_MODE_ADCNR)
+    {
+        counts += PWR_ADCNR_T1_COUNTS;
+        PWR_T0Eighths += PWR_ADCNR_T0_EIGHTHS;
+        cli();
+        // never across an overflow, the debt waits for the next time
+        if (TCNT0 < 256 - 4)
+        {
+            TCNT0 += PWR_T0Eighths >> 3;
+            PWR_T0Eighths &= 7;
+        }
+        sei();
+    }
+#endif
+
+    r = &PWR_Residency[mode];
+    r->sleeps++;
+    r->frac += counts;
+    while (r->frac >= 4096)
+    {
+        r->frac -= 4096;
+        r->ticks++;
+    }
+}
+
+static void PWR_SendMode(const char *name, const PWR_Residency_t *r, u32 per_cent)
+{
+    lcd_sendstring_P(name);
+    lcd_send_number32(r->ticks / per_cent);
+    lcd_sendstring_P(PSTR("% n:"));
+    lcd_send_number32(r->sleeps);
+}
+
+/* DIAGNOSTICS PAGE
+idle 97% n:12345
+adcnr 1% n:1234
+share of the time since reset spent in each mode
+*/
+void PWR_ShowPage(void)
+{
+    u32 per_cent = TIMER0_GetTicks() / 100 + 1;
+
+    lcd_clear();
+    PWR_SendMode(PSTR("idle "), &PWR_Residency[PWR_MODE_IDLE], per_cent);
+    lcd_setcursor(1, 0);
+    PWR_SendMode(PSTR("adcnr "), &PWR_Residency[PWR_MODE_ADCNR], per_cent);
+}
@@ -0,0 +1,124 @@
+#include "profiler.h"
+#include "lcd.h"
+
+#define PROF_TICK_PERIOD 4096 // timer0 overflow period in timer1 counts (16.384ms / 4us)
+
+PROF_Region_t PROF_Regions[PROF_REGIONS];
+
+static u16 PROF_LastTick = 0;
+static u8 PROF_HaveTick = 0;
+
+static const char PROF_Names[PROF_REGIONS][6] PROGMEM = {
+    "T0ISR", "T0LAT", "T0JIT", "ADC  ", "PCINT", "UDRE ", "TLM  ", "TASK0", "TASK1", "TASK2", "TASK3", "TASK4", "TASK5",
+    "TASK6"};
+
+void PROF_Reset(void)
+{
+    for (u8 i = 0; i < PROF_REGIONS; i++)
+    {
+        PROF_Regions[i].min = 0xffff;
+        PROF_Regions[i].max = 0;
+        PROF_Regions[i].sum = 0;
+        PROF_Regions[i].count = 0;
+        for (u8 b = 0; b < PROF_BUCKETS; b++)
+        {
+            PROF_Regions[i].hist[b] = 0;
+        }
+    }
+    PROF_HaveTick = 0;
+}
+
+// called from ISRs and the main loop, keep it short
+void PROF_Record(u8 region, u16 time)
+{
+    PROF_Region_t *r = &PROF_Regions[region];
+    u8 b = 0;
+    u16 t = time;
+    u8 sreg = SREG;
+
+    while (t && b < PROF_BUCKETS - 1)
+    {
+        t >>= 1;
+        b++;
+    }
+
+    cli();
+    if (r->count == 0 || time < r->min)
+    {
+        r->min = time;
+    }
+    if (time > r->max)
+    {
+        r->max = time;
+    }
+    // stop before the mean loses its meaning
+    if (r->count != 0xffff)
+    {
+        r->sum += time;
+        r->count++;
+    }
+    if (r->hist[b] != 0xffff)
+    {
+        r->hist[b]++;
+    }
+    SREG = sreg;
+}
+
+// ISR CONTEXT
+void PROF_TickEntry(void)
+{
+    u16 now = TIMER1_Now();
+    u16 period, jitter;
+
+    // timer0 counts 64us each, 16 timer1 counts
+    PROF_Record(PROF_TICK_LATENCY, (u16)TCNT0 << 4);
+
+    if (PROF_HaveTick)
+    {
+        period = now - PROF_LastTick;
+        jitter = (period > PROF_TICK_PERIOD) ? period - PROF_TICK_PERIOD : PROF_TICK_PERIOD - period;
+        PROF_Record(PROF_TICK_JITTER, jitter);
+    }
+    PROF_LastTick = now;
+    PROF_HaveTick = 1;
+}
+
+static void PROF_SendUs(u32 counts)
+{
+    lcd_send_number32(counts * TIMER1_US_PER_COUNT);
+}
+
+/* DIAGNOSTICS PAGE
+T0ISR n:12345
+min avg max (us)
+*/
+void PROF_ShowPage(u8 region)
+{
+    PROF_Region_t r;
+    u8 sreg = SREG;
+
+    if (region >= PROF_REGIONS)
+    {
+        return;
+    }
+    cli();
+    r = PROF_Regions[region];
+    SREG = sreg;
+
+    lcd_clear();
+    lcd_sendstring_P(PROF_Names[region]);
+    lcd_sendstring_P(PSTR(" n:"));
+    lcd_send_number32(r.count);
+    lcd_setcursor(1, 0);
+    if (r.count == 0)
+    {
+        lcd_sendstring_P(PSTR("no samples"));
+        return;
+    }
+    PROF_SendUs(r.min);
+    lcd_sendchar(' ');
+    PROF_SendUs(r.sum / r.count);
+    lcd_sendchar(' ');
+    PROF_SendUs(r.max);
+    lcd_sendstring_P(PSTR("us"));
+}
@@ -1,23 +1,124 @@
-#include <avr/io.h>
-#include <util/delay.h>
+#include "hal.h"
 #include "DIO.h"
 #include "pushbuttons.h"
+#include "profiler.h"
 
 unsigned char PUSHBUTTON_PINS[4] = {PUSHBUTTON_PIN_UP, PUSHBUTTON_PIN_DN, PUSHBUTTON_PIN_LEFT, PUSHBUTTON_PIN_RIGHT};
 
+// DEBOUNCE STATE
+static volatile unsigned char PB_Activity = 0; // set by any edge, cleared each tick
+static unsigned char PB_Settling = 0;          // edges seen, new state not accepted yet
+static unsigned char PB_Stable = 0;            // debounced pressed pins (1 = pressed)
+static unsigned char PB_HeldKey = 0;           // key being timed for long press/repeat
+static unsigned char PB_HoldTicks = 0;
+
+// EVENT QUEUE, single producer (tick ISR) single consumer (main loop)
+static unsigned char PB_Queue[PUSHBUTTONS_QUEUE_SIZE];
+static volatile unsigned char PB_Head = 0; // written by the producer only
+static volatile unsigned char PB_Tail = 0; // written by the consumer only
+
 // Setting pin directions
 void PUSHBUTTONS_Init(void)
 {
-    for (unsigned char i = 0; i < 4; i++)
+    // Setting as input
+    DIO_DDR(PUSHBUTTON_PRT) &= ~PUSHBUTTON_MASK;
+    // Setting input pins as pullup
+    DIO_PORT(PUSHBUTTON_PRT) |= PUSHBUTTON_MASK;
+
+    // pin change interrupt on the button pins (PCINT0..7 live on port B)
+    PCMSK0 |= PUSHBUTTON_MASK;
+    PCICR |= (1 << 0);
+}
+
+static void PUSHBUTTONS_Push(unsigned char ev)
+{
+    unsigned char next = (PB_Head + 1) & (PUSHBUTTONS_QUEUE_SIZE - 1);
+    if (next != PB_Tail) // drop when full
+    {
+        PB_Queue[PB_Head] = ev;
+        PB_Head = next;
+    }
+}
+
+/* A pin state is accepted once the lines stayed quiet for a full tick,
+so bounces shorter than 16ms never reach the queue
+*/
+void PUSHBUTTONS_Tick(void)
+{
+    unsigned char raw, changed, i;
+
+    // idle, nothing pressed and no edges
+    if (!PB_Activity && !PB_Settling && PB_Stable == 0)
+    {
+        return;
+    }
+
+    if (PB_Activity)
+    {
+        // still bouncing, check again next tick
+        PB_Activity = 0;
+        PB_Settling = 1;
+        return;
+    }
+    PB_Settling = 0;
+
+    // pullups, a pressed button reads 0
+    raw = ~DIO_PINS(PUSHBUTTON_PRT) & PUSHBUTTON_MASK;
+    changed = raw ^ PB_Stable;
+    PB_Stable = raw;
+
+    for (i = 0; i < 4; i++)
+    {
+        unsigned char bit = (1 << PUSHBUTTON_PINS[i]);
+        if (changed & bit)
+        {
+            if (raw & bit)
+            {
+                PUSHBUTTONS_Push(PUSHBUTTONS_EV_PRESS | (i + 1));
+                PB_HeldKey = i + 1;
+                PB_HoldTicks = 0;
+            }
+            else
+            {
+                PUSHBUTTONS_Push(PUSHBUTTONS_EV_RELEASE | (i + 1));
+                if (PB_HeldKey == i + 1)
+                {
+                    PB_HeldKey = 0;
+                }
+            }
+        }
+    }
+
+    // long press then auto repeat of the last pressed key
+    if (PB_HeldKey)
+    {
+        PB_HoldTicks++;
+        if (PB_HoldTicks == PUSHBUTTONS_LONG_TICKS)
+        {
+            PUSHBUTTONS_Push(PUSHBUTTONS_EV_LONG | PB_HeldKey);
+        }
+        else if (PB_HoldTicks == PUSHBUTTONS_LONG_TICKS + PUSHBUTTONS_REPEAT_TICKS)
+        {
+            PUSHBUTTONS_Push(PUSHBUTTONS_EV_REPEAT | PB_HeldKey);
+            PB_HoldTicks = PUSHBUTTONS_LONG_TICKS;
+        }
+    }
+}
+
+unsigned char PUSHBUTTONS_GetEvent(void)
+{
+    unsigned char ev;
+
+    if (PB_Tail == PB_Head)
     {
-        // Setting as input
-        DIO_SetPinDirection(PUSHBUTTON_PRT, PUSHBUTTON_PINS[i], INPUT);
-        // Setting input pins as pullup
-        DIO_WritePin(PUSHBUTTON_PRT, PUSHBUTTON_PINS[i], 1);
+        return 0;
     }
+    ev = PB_Queue[PB_Tail];
+    PB_Tail = (PB_Tail + 1) & (PUSHBUTTONS_QUEUE_SIZE - 1);
+    return ev;
 }
 
-/*FF BUTTONS RELEASED
+/*FF NO NEW PRESS
 1 BUTTON UP
 2 BUTTON DOWN
 3 BUTTON LEFT
@@ -25,44 +126,22 @@ void PUSHBUTTONS_Init(void)
 */
 unsigned char PUSHBUTTONS_Read(void)
 {
-    unsigned char pressedkey = KEYPAD_NO_PRESSED_KEY;
-    unsigned char i = 0;
-
-    unsigned char buttonState = 1;
+    unsigned char ev;
 
-    for (i = 0; i < 4; i++)
+    while ((ev = PUSHBUTTONS_GetEvent()) != 0)
     {
-        // TODO:if pullup, dont forget to invert inputs
-        buttonState = DIO_ReadPin(PUSHBUTTON_PRT, PUSHBUTTON_PINS[i]);
-        // if the button is held in the same state within debounce time, return value
-        if (buttonState == 0)
+        if (PUSHBUTTONS_EV_TYPE(ev) == PUSHBUTTONS_EV_PRESS || PUSHBUTTONS_EV_TYPE(ev) == PUSHBUTTONS_EV_REPEAT)
         {
-            pressedkey = (i + 1);
-            while (buttonState == 0)
-            {
-                buttonState = DIO_ReadPin(PUSHBUTTON_PRT, PUSHBUTTON_PINS[i]);
-            }
-            return pressedkey;
-            /* _delay_ms(DEBOUNCE_DELAY_MS);
-             buttonState = DIO_ReadPin(PUSHBUTTON_PRT, PUSHBUTTON_PINS[i]);
-             if (buttonState == 0)
-             {
-                 pressedkey=(i+1+'0');
-                 return pressedkey;
-             }*/
+            return PUSHBUTTONS_EV_KEY(ev);
         }
     }
-    return pressedkey; // if reaches here without being returned, no key is pressed
+    return KEYPAD_NO_PRESSED_KEY; // no key press waiting
 }
 
-// // enter index as defined in PUSHBUTTON_PINS
-// unsigned char PUSHBUTTONS_debounce(unsigned char state, unsigned char button_index)
-// {
-//     unsigned char stateNow = DIO_GetPinValue(PUSHBUTTON_PRT, PUSHBUTTON_PINS[button_index]);
-//     if (state != stateNow)
-//     {
-//         _delay_ms(DEBOUNCE_DELAY_MS);
-//         stateNow = DIO_GetPinValue(PUSHBUTTON_PRT, PUSHBUTTON_PINS[button_index]);
-//     }
-//     return stateNow;
-// }
\ No newline at end of file
+// ANY EDGE ON THE BUTTON PINS
+ISR(PCINT0_vect)
+{
+    PROF_ENTER();
+    PB_Activity = 1;
+    PROF_EXIT(PROF_ISR_PCINT0);
+}
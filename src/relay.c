@@ -4,19 +4,19 @@
 
 void RELAY_Init(void)
 {
-    DIO_SetPinDirection(HEATER_PRT, HEATER_PIN, OUTPUT);
-    DIO_SetPinDirection(LAMP_PRT, LAMP_PIN, OUTPUT);
+    DIO_PIN_OUTPUT(HEATER_IO);
+    DIO_PIN_OUTPUT(LAMP_IO);
 }
 
 void RELAY_Heater(unsigned char state)
 {
     if (state == 1)
     {
-        DIO_WritePin(HEATER_PRT, HEATER_PIN, 1);
+        DIO_PIN_HIGH(HEATER_IO);
     }
     else if (state == 0)
     {
-        DIO_WritePin(HEATER_PRT, HEATER_PIN, 0);
+        DIO_PIN_LOW(HEATER_IO);
     }
 }
 
@@ -25,31 +25,15 @@ void RELAY_Lamp(unsigned char state)
 
     if (state == 1)
     {
-        DIO_WritePin(LAMP_PRT, LAMP_PIN, 1);
+        DIO_PIN_HIGH(LAMP_IO);
     }
     else if (state == 0)
     {
-        DIO_WritePin(LAMP_PRT, LAMP_PIN, 0);
+        DIO_PIN_LOW(LAMP_IO);
     }
 }
 
-void RELAY_Lamp_Alert(unsigned char timesec)
-{
-    unsigned char state = 0;
-    for (unsigned char i = 0; i < timesec; i++)
-    {
-        _delay_ms(1000);
-        RELAY_Lamp(state);
-        state = ~state; // toggle state
-    }
-}
 void BUZZER_Init(void)
 {
-    DIO_SetPinDirection(BUZZER_PRT, BUZZER_PIN, 1);
-}
-void BUZZER_Pulse_ms(unsigned short ms)
-{
-    DIO_WritePin(BUZZER_PRT, BUZZER_PIN, 1);
-    _delay_ms(ms);
-    DIO_WritePin(BUZZER_PRT, BUZZER_PIN, 0);
+    DIO_PIN_OUTPUT(BUZZER_IO);
 }
\ No newline at end of file
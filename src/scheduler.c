@@ -0,0 +1,124 @@
+#include "scheduler.h"
+#include "timer.h"
+#include "profiler.h"
+
+static SCHED_Task_t *SCHED_Tasks;
+static u8 SCHED_Count = 0;
+static u8 SCHED_Running = 0; // stops a task from dispatching other tasks
+
+void SCHED_Init(SCHED_Task_t *tasks, u8 count)
+{
+    for (u8 i = 0; i < count; i++)
+    {
+        tasks[i].countdown = tasks[i].phase + 1;
+        tasks[i].ready = 0;
+        tasks[i].runs = 0;
+        tasks[i].last_time = 0;
+        tasks[i].worst_time = 0;
+        tasks[i].overruns = 0;
+    }
+    SCHED_Tasks = tasks;
+    SCHED_Count = count;
+}
+
+// ISR CONTEXT
+void SCHED_Tick(void)
+{
+    SCHED_Task_t *t = SCHED_Tasks;
+
+    for (u8 i = SCHED_Count; i != 0; i--, t++)
+    {
+        if (--t->countdown == 0)
+        {
+            t->countdown = t->period;
+            if (t->ready)
+            {
+                t->overruns++;
+            }
+            t->ready = 1;
+        }
+    }
+}
+
+u8 SCHED_Pending(void)
+{
+    if (SCHED_Running)
+    {
+        return 0;
+    }
+    for (u8 i = 0; i < SCHED_Count; i++)
+    {
+        if (SCHED_Tasks[i].ready)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+u8 SCHED_Dispatch(void)
+{
+    SCHED_Task_t *best = 0;
+    unsigned long ticks;
+    u16 start, time;
+
+    if (SCHED_Running)
+    {
+        return 0;
+    }
+
+    for (u8 i = 0; i < SCHED_Count; i++)
+    {
+        if (SCHED_Tasks[i].ready && (best == 0 || SCHED_Tasks[i].priority < best->priority))
+        {
+            best = &SCHED_Tasks[i];
+        }
+    }
+    if (best == 0)
+    {
+        return 0;
+    }
+
+    // byte write, the ISR cannot see it half done
+    best->ready = 0;
+
+    SCHED_Running = 1;
+    ticks = TIMER0_GetTicks();
+    start = TIMER1_Now();
+    best->task();
+    time = TIMER1_Now() - start;
+    // timer1 wraps every 16 ticks, saturate anything longer
+    if (TIMER0_GetTicks() - ticks >= 16)
+    {
+        time = 0xffff;
+    }
+    SCHED_Running = 0;
+
+#if PROFILER_EN
+    if (best - SCHED_Tasks < PROF_TASKS_MAX)
+    {
+        PROF_Record(PROF_TASK0 + (best - SCHED_Tasks), time);
+    }
+#endif
+    best->runs++;
+    best->last_time = time;
+    if (time > best->worst_time)
+    {
+        best->worst_time = time;
+    }
+    return 1;
+}
+
+void SCHED_Delay_ms(u16 ms)
+{
+    // 16.384ms per tick, ticks = ms * 125 / 2048
+    unsigned long end = TIMER0_GetTicks() + (((unsigned long)ms * 125) >> 11);
+
+    while ((long)(end - TIMER0_GetTicks()) > 0)
+    {
+        if (!SCHED_Dispatch())
+        {
+            HAL_Idle();
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#include "hal.h"
+#include "sensor.h"
+
+const SENSOR_Channel_t SENSOR_BodyTemp = {1250, 8, 0, 0};
+const SENSOR_Channel_t SENSOR_RoomTemp = {1250, 8, 0, 0};
+
+s16 SENSOR_Convert(const SENSOR_Channel_t *ch, u16 code)
+{
+    if (ch->table)
+    {
+        u8 i = code >> SENSOR_TABLE_STEP_LOG2;
+        u8 frac = code & ((1 << SENSOR_TABLE_STEP_LOG2) - 1);
+        s16 y0 = (s16)pgm_read_word(&ch->table[i]);
+        s16 y1 = (s16)pgm_read_word(&ch->table[i + 1]);
+        return y0 + (s16)(((s32)(y1 - y0) * frac) >> SENSOR_TABLE_STEP_LOG2) + ch->offset;
+    }
+    return (s16)(((u32)code * ch->gain) >> ch->shift) + ch->offset;
+}
+
+static s16 SENSOR_Median3(s16 a, s16 b, s16 c)
+{
+    if (a > b)
+    {
+        s16 t = a;
+        a = b;
+        b = t;
+    }
+    // a <= b
+    if (c <= a)
+    {
+        return a;
+    }
+    return c < b ? c : b;
+}
+
+s16 SENSOR_Filter(SENSOR_Filter_t *f, s16 x)
+{
+    s16 m;
+
+    if (!f->primed)
+    {
+        // start settled on the first reading
+        f->window[0] = f->window[1] = f->window[2] = x;
+        f->acc = (s32)x << f->shift;
+        f->primed = 1;
+    }
+
+    f->window[f->pos] = x;
+    f->pos = f->pos == 2 ? 0 : f->pos + 1;
+    m = SENSOR_Median3(f->window[0], f->window[1], f->window[2]);
+
+    f->acc += m - (f->acc >> f->shift);
+    // round to nearest
+    return (s16)((f->acc + ((1L << f->shift) >> 1)) >> f->shift);
+}
+
+u8 SENSOR_Above(u8 state, s16 value, s16 level, s16 band)
+{
+    if (value > level)
+    {
+        return 1;
+    }
+    if (value < level - band)
+    {
+        return 0;
+    }
+    return state;
+}
+
+u8 SENSOR_Below(u8 state, s16 value, s16 level, s16 band)
+{
+    if (value < level)
+    {
+        return 1;
+    }
+    if (value > level + band)
+    {
+        return 0;
+    }
+    return state;
+}
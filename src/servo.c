@@ -1,22 +1,49 @@
-#include <servo.h>
+#include "servo.h"
 
-#define SERVO_PRT 'D'
-#define SERVO_PIN 3
+#define SERVO_IO D, 3 // OC2B
 #define SERVO_TIMER
 
-// Timer 2 Phase correct pwm, main frequency 50hz
+#define SERVO_OCR_STOP 12 // OCR2B for no motion, left is lower, right is higher
+
+// MOTION STATE
+static unsigned char SERVO_Queue[SERVO_QUEUE_SIZE];
+static volatile unsigned char SERVO_Head = 0; // written by SERVO_Move only
+static volatile unsigned char SERVO_Tail = 0; // written by SERVO_Tick only
+static volatile unsigned char SERVO_State = SERVO_IDLE;
+static volatile unsigned char SERVO_Current = SERVO_POSTURE_SIT;
+static volatile unsigned char SERVO_Ready = 0; // PWM set up
+static unsigned char SERVO_Target;
+static unsigned char SERVO_Elapsed;
+
 void SERVO_Init(void)
 {
+    DIO_PIN_OUTPUT(SERVO_IO);
+    SERVO_Ready = 0;
+}
 
-    DIO_SetPinDirection(SERVO_PRT, SERVO_PIN, OUTPUT);
-    _delay_ms(1000);
+// Timer 2 Phase correct pwm, main frequency 50hz
+void SERVO_Start(void)
+{
     // TODO: initialize timer2 in phase correct PWM mode
     // TCCR2B |= 0b01
     TCCR2A |= (1 << 0) | (1 << 5); // compare output mode on at B (pin 3)
-    TCCR2B |= 0x0F;                // set first 3 bits prescaler = 1024 and WGM22 is set
+    TCCR2B |= (1 << 3);            // WGM22, SERVO_On selects the clock for each move
     OCR2A = 156;                   // top of phase correct pwm
     // OCR2B is to be set depending on the desired servo direction
-    _delay_ms(10);
+    SERVO_Ready = 1;
+}
+
+unsigned char SERVO_Started(void)
+{
+    return SERVO_Ready;
+}
+
+void SERVO_SetPosture(unsigned char posture)
+{
+    if (SERVO_State == SERVO_IDLE)
+    {
+        SERVO_Current = posture;
+    }
 }
 
 /*
@@ -50,4 +77,77 @@ void SERVO_On(unsigned char cmd)
 void SERVO_Off(void)
 {
     TCCR2B &= ~((1 << 0) | (1 << 1) | (1 << 2)); // clear bits 0:2
-}
\ No newline at end of file
+}
+
+unsigned char SERVO_Move(unsigned char posture)
+{
+    unsigned char next = (SERVO_Head + 1) & (SERVO_QUEUE_SIZE - 1);
+    if (next == SERVO_Tail)
+    {
+        return 0;
+    }
+    SERVO_Queue[SERVO_Head] = posture;
+    SERVO_Head = next;
+    return 1;
+}
+
+/* Trapezoid speed profile: the speed rises one step every 2 ticks up to
+SERVO_SPEED_MAX, cruises, and falls the same way before the end
+*/
+void SERVO_Tick(void)
+{
+    unsigned char up, down, speed;
+
+    // queued moves wait for the PWM
+    if (!SERVO_Ready)
+    {
+        return;
+    }
+
+    if (SERVO_State == SERVO_IDLE)
+    {
+        if (SERVO_Tail == SERVO_Head)
+        {
+            return;
+        }
+        SERVO_Target = SERVO_Queue[SERVO_Tail];
+        SERVO_Tail = (SERVO_Tail + 1) & (SERVO_QUEUE_SIZE - 1);
+        if (SERVO_Target == SERVO_Current)
+        {
+            return; // already there
+        }
+        SERVO_Elapsed = 0;
+        SERVO_State = SERVO_MOVING;
+        SERVO_On(0);
+        return;
+    }
+
+    SERVO_Elapsed++;
+    if (SERVO_Elapsed >= SERVO_MOVE_TICKS)
+    {
+        OCR2B = SERVO_OCR_STOP;
+        SERVO_Off();
+        SERVO_Current = SERVO_Target;
+        SERVO_State = SERVO_IDLE;
+        return;
+    }
+
+    up = SERVO_Elapsed >> SERVO_RAMP_SHIFT;
+    down = (SERVO_MOVE_TICKS - SERVO_Elapsed) >> SERVO_RAMP_SHIFT;
+    speed = up < down ? up : down;
+    if (speed > SERVO_SPEED_MAX)
+    {
+        speed = SERVO_SPEED_MAX;
+    }
+    OCR2B = (SERVO_Target == SERVO_POSTURE_SLEEP) ? SERVO_OCR_STOP - speed : SERVO_OCR_STOP + speed;
+}
+
+unsigned char SERVO_Status(void)
+{
+    return SERVO_State;
+}
+
+unsigned char SERVO_Posture(void)
+{
+    return SERVO_Current;
+}
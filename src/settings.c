@@ -0,0 +1,57 @@
+#include <stddef.h>
+#include "settings.h"
+#include "crc.h"
+
+static u8 SETTINGS_Slot = 1; // copy holding the current settings
+
+// field by field, a host build pads the struct before cal_zero
+static u16 SETTINGS_Crc(const SETTINGS_t *s)
+{
+    u16 crc = CRC16_Block(CRC16_INIT, s, offsetof(SETTINGS_t, mode) + 1);
+
+    crc = CRC16_Block(crc, &s->cal_zero, sizeof(s->cal_zero));
+    return CRC16_Block(crc, &s->cal_gain, sizeof(s->cal_gain));
+}
+
+static u8 SETTINGS_Read(u8 slot, SETTINGS_t *s)
+{
+    EEPROM_ReadBlock(EEPROM_SETTINGS_START + slot * SETTINGS_SLOT_SIZE, (u8 *)s, sizeof(SETTINGS_t));
+    return s->version == SETTINGS_VERSION && s->crc == SETTINGS_Crc(s);
+}
+
+u8 SETTINGS_Load(SETTINGS_t *s)
+{
+    SETTINGS_t a, b;
+    u8 va = SETTINGS_Read(0, &a);
+    u8 vb = SETTINGS_Read(1, &b);
+
+    if (va && (!vb || (s8)(a.seq - b.seq) > 0))
+    {
+        *s = a;
+        SETTINGS_Slot = 0;
+        return 1;
+    }
+    if (vb)
+    {
+        *s = b;
+        SETTINGS_Slot = 1;
+        return 1;
+    }
+    return 0;
+}
+
+u8 SETTINGS_Save(SETTINGS_t *s)
+{
+    u8 slot = SETTINGS_Slot ^ 1;
+
+    s->version = SETTINGS_VERSION;
+    s->seq++;
+    s->crc = SETTINGS_Crc(s);
+    if (!EEPROM_WriteBlock(EEPROM_SETTINGS_START + slot * SETTINGS_SLOT_SIZE, (const u8 *)s, sizeof(SETTINGS_t)))
+    {
+        s->seq--;
+        return 0;
+    }
+    SETTINGS_Slot = slot;
+    return 1;
+}
@@ -0,0 +1,169 @@
+#include "telemetry.h"
+#include "uart.h"
+#include "crc.h"
+#include "timer.h"
+#include "profiler.h"
+
+#if TELEMETRY_EN
+
+u8 TLM_SampleDiv = TLM_SAMPLE_DIV;
+
+static u8 TLM_Seq = 0;
+static u16 TLM_Sent = 0;
+static u16 TLM_Dropped = 0;
+static u8 TLM_MinFree = UART_TX_SIZE - 1;
+static u8 TLM_SampleCount = 0;
+static u8 TLM_StateAge = 0;
+static u8 TLM_StatsAge = 0;
+static TLM_State_t TLM_LastState;
+
+/* ENCODER
+CRC and COBS in one pass: bytes are copied into the frame, a zero closes
+the current block by writing its length into the block's code byte.
+Frames stay below 254 bytes, so there are no full length blocks.
+*/
+typedef struct
+{
+    u8 frame[TLM_FRAME_MAX];
+    u8 code; // index of the open block's code byte
+    u8 len;
+    u16 crc;
+} TLM_Encoder_t;
+
+static void TLM_Put(TLM_Encoder_t *e, u8 b)
+{
+    e->crc = CRC16_Update(e->crc, b);
+    if (b)
+    {
+        e->frame[e->len++] = b;
+    }
+    else
+    {
+        e->frame[e->code] = e->len - e->code;
+        e->code = e->len++;
+    }
+}
+
+static void TLM_Send(u8 type, const u8 *payload, u8 len)
+{
+    TLM_Encoder_t e;
+    u16 tick = (u16)TIMER0_GetTicks();
+    u16 crc;
+    u8 free;
+    PROF_ENTER();
+
+    e.code = 0;
+    e.len = 1;
+    e.crc = CRC16_INIT;
+    TLM_Put(&e, type);
+    TLM_Put(&e, TLM_Seq++);
+    TLM_Put(&e, (u8)tick);
+    TLM_Put(&e, (u8)(tick >> 8));
+    while (len--)
+    {
+        TLM_Put(&e, *payload++);
+    }
+    crc = e.crc;
+    TLM_Put(&e, (u8)crc);
+    TLM_Put(&e, (u8)(crc >> 8));
+    e.frame[e.code] = e.len - e.code;
+    e.frame[e.len++] = 0x00;
+
+    free = UART_Free();
+    if (UART_Write(e.frame, e.len))
+    {
+        TLM_Sent++;
+        free -= e.len;
+    }
+    else
+    {
+        TLM_Dropped++;
+    }
+    if (free < TLM_MinFree)
+    {
+        TLM_MinFree = free;
+    }
+    PROF_EXIT(PROF_TLM);
+}
+
+static u8 TLM_Put16(u8 *p, u16 v)
+{
+    p[0] = (u8)v;
+    p[1] = (u8)(v >> 8);
+    return 2;
+}
+
+void TLM_Init(void)
+{
+    UART_Init();
+    TLM_Seq = 0;
+    TLM_Sent = 0;
+    TLM_Dropped = 0;
+    TLM_MinFree = UART_TX_SIZE - 1;
+    TLM_SampleCount = 0;
+    TLM_StateAge = TLM_STATE_KEEPALIVE; // first state goes out right away
+    TLM_StatsAge = 0;
+}
+
+void TLM_Sample(const TLM_Sample_t *s)
+{
+    u8 p[11], n = 0;
+
+    if (!TLM_SampleDiv || ++TLM_SampleCount < TLM_SampleDiv)
+    {
+        return;
+    }
+    TLM_SampleCount = 0;
+    n += TLM_Put16(&p[n], (u16)s->body);
+    n += TLM_Put16(&p[n], (u16)s->room);
+    n += TLM_Put16(&p[n], s->weight);
+    n += TLM_Put16(&p[n], s->raw);
+    n += TLM_Put16(&p[n], s->duty);
+    p[n++] = s->flags;
+    TLM_Send(TLM_REC_SAMPLE, p, n);
+}
+
+void TLM_State(const TLM_State_t *s)
+{
+    u8 p[6];
+
+    if (++TLM_StateAge < TLM_STATE_KEEPALIVE && s->mode == TLM_LastState.mode &&
+        s->heater_enable == TLM_LastState.heater_enable && s->heater_threshold == TLM_LastState.heater_threshold &&
+        s->lamp_enable == TLM_LastState.lamp_enable && s->lamp_state == TLM_LastState.lamp_state &&
+        s->alarms == TLM_LastState.alarms)
+    {
+        return;
+    }
+    TLM_StateAge = 0;
+    TLM_LastState = *s;
+    p[0] = s->mode;
+    p[1] = s->heater_enable;
+    p[2] = s->heater_threshold;
+    p[3] = s->lamp_enable;
+    p[4] = s->lamp_state;
+    p[5] = s->alarms;
+    TLM_Send(TLM_REC_STATE, p, sizeof(p));
+}
+
+void TLM_Alarm(u8 slot, u8 raised)
+{
+    u8 p[2] = {slot, raised};
+    TLM_Send(TLM_REC_ALARM, p, sizeof(p));
+}
+
+void TLM_Second(void)
+{
+    u8 p[5];
+
+    if (++TLM_StatsAge < TLM_STATS_PERIOD)
+    {
+        return;
+    }
+    TLM_StatsAge = 0;
+    TLM_Put16(&p[0], TLM_Sent);
+    TLM_Put16(&p[2], TLM_Dropped);
+    p[4] = TLM_MinFree;
+    TLM_Send(TLM_REC_STATS, p, sizeof(p));
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include "timer.h"
 
+volatile unsigned long TIMER0_Ticks = 0;
+
 void TIMER0_Init(void)
 {
     sei();
@@ -8,3 +10,43 @@ void TIMER0_Init(void)
     TIMSK0 |= (1 << 0);            // timer overflow interrupt enable
     _delay_us(100);
 }
+
+unsigned long TIMER0_GetTicks(void)
+{
+    unsigned char sreg = SREG;
+    cli();
+    unsigned long ticks = TIMER0_Ticks;
+    SREG = sreg;
+    return ticks;
+}
+
+unsigned long TIMER0_Micros(void)
+{
+    unsigned char sreg = SREG;
+    cli();
+    unsigned long ticks = TIMER0_Ticks;
+    unsigned char count = TCNT0;
+    // overflow not served yet
+    if ((TIFR0 & (1 << 0)) && count < 255)
+    {
+        ticks++;
+    }
+    SREG = sreg;
+    return ((ticks << 8) + count) * 64;
+}
+
+void TIMER1_Init(void)
+{
+    TCCR1A = 0x00;                 // normal mode
+    TCCR1B = (1 << 0) | (1 << 1);  // Prescaler 64
+}
+
+unsigned short TIMER1_Now(void)
+{
+    // 16 bit read goes through the shared TEMP register
+    unsigned char sreg = SREG;
+    cli();
+    unsigned short now = TCNT1;
+    SREG = sreg;
+    return now;
+}
@@ -0,0 +1,68 @@
+#include "uart.h"
+#include "hal.h"
+#include "BIT_MATH.h"
+#include "profiler.h"
+
+// TX RING, single producer (main) single consumer (UDRE ISR)
+static u8 UART_Ring[UART_TX_SIZE];
+static volatile u8 UART_Head = 0; // written by the producer only
+static volatile u8 UART_Tail = 0; // written by the consumer only
+static volatile u8 UART_Sent = 0; // a byte went out since UART_Init, TXC0 is meaningful
+
+void UART_Init(void)
+{
+    UART_Head = 0;
+    UART_Tail = 0;
+    UART_Sent = 0;
+    UBRR0 = UART_UBRR;
+    UCSR0A = (1 << 1);            // U2X0
+    UCSR0C = (1 << 2) | (1 << 1); // UCSZ01:0, 8 data bits, no parity, 1 stop
+    UCSR0B = (1 << 3);            // TXEN0, UDRIE0 stays off until there is data
+}
+
+u8 UART_Free(void)
+{
+    return (UART_Tail - UART_Head - 1) & (UART_TX_SIZE - 1);
+}
+
+u8 UART_Idle(void)
+{
+    return UART_Tail == UART_Head && (!UART_Sent || (UCSR0A & (1 << 6))); // TXC0
+}
+
+u8 UART_Write(const u8 *data, u8 len)
+{
+    u8 head = UART_Head;
+
+    if (len > UART_Free())
+    {
+        return 0;
+    }
+    while (len--)
+    {
+        UART_Ring[head] = *data++;
+        head = (head + 1) & (UART_TX_SIZE - 1);
+    }
+    UART_Head = head;  // publish the bytes before enabling the consumer
+    SET_BIT(UCSR0B, 5); // UDRIE0
+    return 1;
+}
+
+ISR(USART_UDRE_vect)
+{
+    PROF_ENTER();
+    u8 tail = UART_Tail;
+
+    if (tail == UART_Head)
+    {
+        CLR_BIT(UCSR0B, 5); // UDRIE0, ring empty
+    }
+    else
+    {
+        UCSR0A = (1 << 6) | (1 << 1); // clear TXC0, keep U2X0
+        UDR0 = UART_Ring[tail];
+        UART_Sent = 1;
+        UART_Tail = (tail + 1) & (UART_TX_SIZE - 1);
+    }
+    PROF_EXIT(PROF_ISR_UDRE);
+}
@@ -0,0 +1,69 @@
+// Fixed point conversion against the float formula it replaced, every ADC code
+// pio test -e native
+#include <math.h>
+#include <unity.h>
+#include "../../src/sensor.c" // the module under test, built into the test
+
+// LM35 on AVCC as it was computed before, in C
+static double LM35(u16 code)
+{
+    return code * (5.0 / 1024) * 1000 / 10;
+}
+
+#define LM35_DC(code) ((s16)((code) * 5000L / 1024))
+static const s16 LM35_Table[SENSOR_TABLE_POINTS] PROGMEM = SENSOR_TABLE(LM35_DC);
+static const SENSOR_Channel_t LM35_Tabled = {0, 0, 0, LM35_Table};
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+// gain/shift truncates, never more than one 0.1 C step under the float value
+static void test_gain_matches_float(void)
+{
+    u16 code;
+
+    for (code = 0; code < 1024; code++)
+    {
+        double want = LM35(code) * 10;
+        s16 got = SENSOR_Convert(&SENSOR_BodyTemp, code);
+
+        TEST_ASSERT_EQUAL_INT16((s16)floor(want), got);
+        TEST_ASSERT_TRUE(want - got < 1.0);
+        TEST_ASSERT_EQUAL_INT16(got, SENSOR_Convert(&SENSOR_RoomTemp, code));
+    }
+}
+
+// table of the same curve, the point and the interpolation truncate once each
+static void test_table_matches_float(void)
+{
+    u16 code;
+
+    for (code = 0; code < 1024; code++)
+    {
+        double err = LM35(code) * 10 - SENSOR_Convert(&LM35_Tabled, code);
+
+        TEST_ASSERT_TRUE(err >= 0 && err < 2.0);
+    }
+}
+
+static void test_offset_added(void)
+{
+    const SENSOR_Channel_t ch = {1250, 8, -20, 0};
+
+    TEST_ASSERT_EQUAL_INT16(-20, SENSOR_Convert(&ch, 0));
+    TEST_ASSERT_EQUAL_INT16(4975, SENSOR_Convert(&ch, 1023));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_gain_matches_float);
+    RUN_TEST(test_table_matches_float);
+    RUN_TEST(test_offset_added);
+    return UNITY_END();
+}
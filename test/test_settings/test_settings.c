@@ -0,0 +1,96 @@
+// Settings copies through a RAM EEPROM, the CRC must not see padding
+// pio test -e native
+#include <string.h>
+#include <unity.h>
+#include "../../src/settings.c" // the module under test, built into the test
+#include "../../src/crc.c"
+
+static u8 Eeprom[2 * SETTINGS_SLOT_SIZE];
+
+void EEPROM_ReadBlock(u16 addr, u8 *dst, u8 len)
+{
+    memcpy(dst, &Eeprom[addr - EEPROM_SETTINGS_START], len);
+}
+
+u8 EEPROM_WriteBlock(u16 addr, const u8 *src, u8 len)
+{
+    memcpy(&Eeprom[addr - EEPROM_SETTINGS_START], src, len);
+    return 1;
+}
+
+static void Fill(SETTINGS_t *s, u8 junk)
+{
+    memset(s, junk, sizeof(*s)); // whatever the padding holds
+    s->seq = 0;
+    s->heater_threshold = 22;
+    s->heater_enable = 1;
+    s->lamp_enable = 0;
+    s->lamp_state = 0;
+    s->mode = 1;
+    s->cal_zero = 4096;
+    s->cal_gain = 2731;
+}
+
+void setUp(void)
+{
+    memset(Eeprom, 0xff, sizeof(Eeprom));
+    SETTINGS_Slot = 1;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_crc_ignores_padding(void)
+{
+    SETTINGS_t a, b;
+
+    Fill(&a, 0x00);
+    Fill(&b, 0xa5);
+    SETTINGS_Save(&a);
+    SETTINGS_Save(&b);
+    TEST_ASSERT_EQUAL_UINT16(a.crc, b.crc);
+}
+
+static void test_newest_copy_loads(void)
+{
+    SETTINGS_t s, out;
+
+    Fill(&s, 0x5a);
+    SETTINGS_Save(&s);
+    s.heater_threshold = 25;
+    SETTINGS_Save(&s);
+    TEST_ASSERT_TRUE(SETTINGS_Load(&out));
+    TEST_ASSERT_EQUAL_UINT8(25, out.heater_threshold);
+    TEST_ASSERT_EQUAL_UINT16(2731, out.cal_gain);
+}
+
+static void test_torn_copy_falls_back(void)
+{
+    SETTINGS_t s, out;
+
+    Fill(&s, 0x00);
+    SETTINGS_Save(&s); // slot 0
+    s.heater_threshold = 25;
+    SETTINGS_Save(&s); // slot 1
+    Eeprom[SETTINGS_SLOT_SIZE + offsetof(SETTINGS_t, cal_gain)] ^= 0x01;
+    TEST_ASSERT_TRUE(SETTINGS_Load(&out));
+    TEST_ASSERT_EQUAL_UINT8(22, out.heater_threshold);
+}
+
+static void test_blank_eeprom_loads_nothing(void)
+{
+    SETTINGS_t out;
+
+    TEST_ASSERT_FALSE(SETTINGS_Load(&out));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_crc_ignores_padding);
+    RUN_TEST(test_newest_copy_loads);
+    RUN_TEST(test_torn_copy_falls_back);
+    RUN_TEST(test_blank_eeprom_loads_nothing);
+    return UNITY_END();
+}
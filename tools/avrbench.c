@@ -0,0 +1,615 @@
+/* CYCLE BENCHMARK
+Runs the ATmega328p firmware image under simavr and counts the CPU cycles of
+the hot paths, exactly, from their first instruction up to and with their
+return: the call or the interrupt response before it and the interrupts taken
+meanwhile are left out. The firmware runs its normal session, the key script
+walks the menus and the ADC inputs see ~60 on the weight scale, 36.1 C body
+and 22 C room temperature, so two runs of the same image give the same counts.
+Paths the firmware does not call on its own (the blocking ADC_Read,
+PUSHBUTTONS_Read, a 16 character lcd_sendstring and the flush of that line)
+are called once at the end from the main loop, with interrupts off.
+
+  cc -O2 -o avrbench tools/avrbench.c -lsimavr -lelf
+  pio run -e uno
+  ./avrbench -b tools/avrbench_baseline.csv -o bench.csv .pio/build/uno/firmware.elf
+  ./avrbench -b tools/avrbench_baseline.csv -w .pio/build/uno/firmware.elf   records the baseline
+
+Each path reports its calls and min/mean/max cycles, bench.csv has the same
+per path. The max is checked against the baseline: above baseline * (100 +
+threshold) / 100 fails the path, so does a path the image has but the run
+never reached, and so does a path with no count in the baseline (0): the
+benchmark gates nothing until the baseline is recorded. Paths the image does
+not have at all (the USART ISR without telemetry) are only reported absent,
+unless the baseline has a count for them.
+-w writes the max of this run as the new baseline and keeps the thresholds.
+Exits with 1 if a path failed.
+*/
+#include <gelf.h>
+#include <fcntl.h>
+#include <libelf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <simavr/avr_adc.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_uart.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_core.h>
+#include <simavr/sim_elf.h>
+
+#define F_CPU 16000000UL
+#define FLASH_BYTES 32768
+#define VECTORS_BYTES (26 * 4) // ATmega328p vector table, jmp per vector
+#define FRAMES 32
+#define ADDR_SMCR 0x53
+#define ADDR_ADCSRA 0x7a
+#define KEY_PERIOD (3 * F_CPU) // one key each 3s held 100ms, like the native build
+#define KEY_HOLD (F_CPU / 10)
+#define DEFAULT_THRESHOLD 1 // per cent
+
+#define TRACE 0      // counted each time the firmware runs it
+#define CALL 1       // called once at the end
+#define ARG_LINE -1  // r25:r24 points to a 16 character string
+
+typedef struct
+{
+    const char *name; // 0 for an untimed call setting up the next one
+    const char *symbol;
+    int kind;
+    int arg0, arg1; // CALL: r24 and r22
+    uint32_t addr;
+    unsigned long calls;
+    uint64_t min, max, sum;
+    unsigned long baseline; // max cycles, 0 not recorded yet
+    int threshold;          // per cent
+} Path_t;
+
+static Path_t Paths[] = {
+    {"timer0_isr", "__vector_16", TRACE},
+    {"adc_isr", "__vector_21", TRACE},
+    {"pcint0_isr", "__vector_3", TRACE},
+    {"uart_udre_isr", "__vector_19", TRACE},
+    {"pushbuttons_tick", "PUSHBUTTONS_Tick", TRACE},
+    {"sensor_convert", "SENSOR_Convert", TRACE},
+    {"loadcell_weight", "LOADCELL_ReadWeight", TRACE},
+    {"menu_render", "MENU_Goto", TRACE},
+    {"menu_poll", "MENU_Poll", TRACE},
+    {"lcd_flush", "LCD_Flush", TRACE},
+    {"lcd_senddata", "LCD_SendData", TRACE},
+    {"adc_read", "ADC_Read", CALL, 1},
+    {"pushbuttons_read", "PUSHBUTTONS_Read", CALL},
+    {0, "lcd_setcursor", CALL, 1, 0},
+    {"lcd_sendstring_16", "lcd_sendstring", CALL, ARG_LINE},
+    {"lcd_flush_line", "LCD_FlushAll", CALL},
+};
+#define PATHS (sizeof(Paths) / sizeof(Paths[0]))
+
+// where the calls at the end are made from, the first one the image has
+static const char *Quiet[] = {"PWR_Idle", "LCD_Flush"};
+
+static const struct
+{
+    int channel;
+    uint32_t mv;
+} Inputs[] = {
+    {1, 879}, // load cell, ~60 on the weight scale
+    {2, 361}, // body temperature, LM35 at 36.1 C
+    {3, 220}, // room temperature, 22 C
+};
+
+typedef struct
+{
+    int path;              // -1 for an interrupt
+    uint32_t ret;          // byte address
+    uint16_t sp;           // at the first instruction
+    uint64_t start, inner; // cycles, inner: interrupts taken meanwhile
+    uint32_t prev;         // pc before the interrupt
+} Frame_t;
+
+typedef struct
+{
+    char *name;
+    uint32_t addr;
+} Symbol_t;
+
+static avr_t *Avr;
+static uint8_t Entry[FLASH_BYTES / 2]; // path + 1 at the first instruction of each traced path
+static Frame_t Frames[FRAMES];
+static int Depth;
+static uint32_t PrevPc;
+static int NrStarted;
+static Symbol_t *Symbols;
+static size_t SymbolCount;
+
+static int read_symbols(const char *file)
+{
+    Elf *e;
+    Elf_Scn *scn = 0;
+    GElf_Shdr sh;
+    GElf_Sym s;
+    Elf_Data *d;
+    int fd = open(file, O_RDONLY);
+
+    if (fd < 0 || elf_version(EV_CURRENT) == EV_NONE || !(e = elf_begin(fd, ELF_C_READ, 0)))
+    {
+        return -1;
+    }
+    while ((scn = elf_nextscn(e, scn)) != 0)
+    {
+        if (!gelf_getshdr(scn, &sh) || sh.sh_type != SHT_SYMTAB || !(d = elf_getdata(scn, 0)))
+        {
+            continue;
+        }
+        for (size_t i = 0; i < sh.sh_size / sh.sh_entsize; i++)
+        {
+            if (!gelf_getsym(d, (int)i, &s) || GELF_ST_TYPE(s.st_info) != STT_FUNC)
+            {
+                continue;
+            }
+            Symbols = realloc(Symbols, (SymbolCount + 1) * sizeof(*Symbols));
+            Symbols[SymbolCount].name = strdup(elf_strptr(e, sh.sh_link, s.st_name));
+            Symbols[SymbolCount].addr = (uint32_t)s.st_value;
+            SymbolCount++;
+        }
+    }
+    elf_end(e);
+    close(fd);
+    return 0;
+}
+
+// 0 if the image does not have it (inlined or gone), the reset vector is no function
+static uint32_t symbol(const char *name)
+{
+    for (size_t i = 0; i < SymbolCount; i++)
+    {
+        if (!strcmp(Symbols[i].name, name))
+        {
+            return Symbols[i].addr;
+        }
+    }
+    return 0;
+}
+
+static uint16_t sp_get(void)
+{
+    return (uint16_t)(Avr->data[R_SPL] | Avr->data[R_SPH] << 8);
+}
+
+static void sp_set(uint16_t sp)
+{
+    Avr->data[R_SPL] = sp & 0xff;
+    Avr->data[R_SPH] = sp >> 8;
+}
+
+// return address on top of the stack, pushed low byte first as a word address
+static uint32_t ret_addr(uint16_t sp)
+{
+    return (uint32_t)(Avr->data[sp + 1] << 8 | Avr->data[sp + 2]) * 2;
+}
+
+static void record(Path_t *p, uint64_t n)
+{
+    if (!p->calls || n < p->min)
+    {
+        p->min = n;
+    }
+    if (n > p->max)
+    {
+        p->max = n;
+    }
+    p->sum += n;
+    p->calls++;
+}
+
+static void push(int path, uint32_t ret, uint16_t sp)
+{
+    Frame_t *f;
+
+    if (Depth == FRAMES)
+    {
+        fprintf(stderr, "avrbench: more than %d nested frames at pc 0x%x\n", FRAMES, (unsigned)Avr->pc);
+        exit(2);
+    }
+    f = &Frames[Depth++];
+    f->path = path;
+    f->ret = ret;
+    f->sp = sp;
+    f->start = Avr->cycle;
+    f->inner = 0;
+    f->prev = PrevPc;
+}
+
+// one instruction, and the interrupt after it if one is taken
+static int step(void)
+{
+    uint8_t adcsra = Avr->data[ADDR_ADCSRA];
+    uint32_t pc;
+    uint16_t sp;
+    Frame_t *f;
+    uint64_t n;
+    int state;
+
+    // entering ADC noise reduction sleep starts a conversion on the chip, not in simavr
+    if (Avr->state != cpu_Sleeping)
+    {
+        NrStarted = 0;
+    }
+    else if (!NrStarted && (Avr->data[ADDR_SMCR] & 0x0e) == 0x02 && (adcsra & 0xc0) == 0x80) // SM 001, ADEN without ADSC
+    {
+        NrStarted = 1;
+        avr_core_watch_write(Avr, ADDR_ADCSRA, (adcsra & ~0x10) | 0x40); // ADSC, ADIF left alone
+    }
+
+    state = avr_run(Avr);
+    pc = Avr->pc;
+    sp = sp_get();
+    if (pc == PrevPc)
+    {
+        return state; // asleep
+    }
+    // an interrupt and the path it came in at the return of can end together
+    while (Depth && pc == Frames[Depth - 1].ret && sp == Frames[Depth - 1].sp + 2)
+    {
+        f = &Frames[--Depth];
+        n = Avr->cycle - f->start;
+        if (f->path < 0)
+        {
+            PrevPc = f->prev; // a call the interrupt came in after still counts
+            if (Depth)
+            {
+                Frames[Depth - 1].inner += n;
+            }
+            continue;
+        }
+        record(&Paths[f->path], n - f->inner);
+        if (Depth)
+        {
+            Frames[Depth - 1].inner += f->inner;
+        }
+    }
+
+    if (pc && pc < VECTORS_BYTES)
+    {
+        push(-1, ret_addr(sp), sp);
+    }
+    else if (Entry[pc >> 1])
+    {
+        // entered by a call or the jmp of a vector, not by a branch back to the top
+        uint32_t ret = ret_addr(sp);
+        if (PrevPc < VECTORS_BYTES || ret - PrevPc == 2 || ret - PrevPc == 4)
+        {
+            push(Entry[pc >> 1] - 1, ret, sp);
+        }
+    }
+    PrevPc = pc;
+    return state;
+}
+
+// runs a CALL path from the first instruction of a main loop function
+static int call(Path_t *p)
+{
+    static const char line[] = "0123456789abcdef";
+    uint8_t regs[32], sreg[8];
+    uint32_t pc = Avr->pc;
+    uint16_t sp = sp_get(), top = sp;
+    uint64_t start;
+    int state;
+
+    memcpy(regs, Avr->data, sizeof(regs));
+    memcpy(sreg, Avr->sreg, sizeof(sreg));
+    Avr->sreg[S_I] = 0;
+    if (p->arg0 == ARG_LINE)
+    {
+        // string in free stack below the caller
+        top = sp - 32;
+        memcpy(&Avr->data[top], line, sizeof(line));
+        Avr->data[24] = top & 0xff;
+        Avr->data[25] = top >> 8;
+        top--;
+    }
+    else
+    {
+        Avr->data[24] = (uint8_t)p->arg0;
+        Avr->data[25] = 0;
+        Avr->data[22] = (uint8_t)p->arg1;
+    }
+    Avr->data[top] = (pc / 2) & 0xff;
+    Avr->data[top - 1] = (uint8_t)((pc / 2) >> 8);
+    sp_set(top - 2);
+
+    Avr->pc = p->addr;
+    start = Avr->cycle;
+    do
+    {
+        state = avr_run(Avr);
+        if (state == cpu_Done || state == cpu_Crashed)
+        {
+            return -1;
+        }
+    } while (Avr->pc != pc || sp_get() != top);
+    if (p->name)
+    {
+        record(p, Avr->cycle - start);
+    }
+
+    memcpy(Avr->data, regs, sizeof(regs));
+    memcpy(Avr->sreg, sreg, sizeof(sreg));
+    sp_set(sp);
+    return 0;
+}
+
+static void key(int k, int down)
+{
+    avr_raise_irq(avr_io_getirq(Avr, AVR_IOCTL_IOPORT_GETIRQ('B'), k - 1), !down);
+}
+
+// the sleeping firmware takes no host time
+static void no_sleep(avr_t *avr, avr_cycle_count_t how_long)
+{
+}
+
+static Path_t *find_path(const char *name)
+{
+    for (size_t i = 0; i < PATHS; i++)
+    {
+        if (Paths[i].name && !strcmp(Paths[i].name, name))
+        {
+            return &Paths[i];
+        }
+    }
+    return 0;
+}
+
+static int read_baseline(const char *file)
+{
+    char buf[128], name[64];
+    unsigned long cycles;
+    int threshold;
+    Path_t *p;
+    FILE *f = fopen(file, "r");
+
+    if (!f)
+    {
+        return -1;
+    }
+    while (fgets(buf, sizeof(buf), f))
+    {
+        if (buf[0] == '#' || sscanf(buf, "%63[^,],%lu,%d", name, &cycles, &threshold) != 3)
+        {
+            continue;
+        }
+        if (!(p = find_path(name)))
+        {
+            fprintf(stderr, "avrbench: %s: no path %s\n", file, name);
+            continue;
+        }
+        p->baseline = cycles;
+        p->threshold = threshold;
+    }
+    fclose(f);
+    return 0;
+}
+
+static int write_baseline(const char *file)
+{
+    FILE *f = fopen(file, "w");
+
+    if (!f)
+    {
+        return -1;
+    }
+    fprintf(f, "# path,cycles,threshold_pct\n");
+    fprintf(f, "# max cycles of each path, 0 not recorded yet and fails the run: record with -w, see tools/avrbench.c\n");
+    for (size_t i = 0; i < PATHS; i++)
+    {
+        if (Paths[i].name)
+        {
+            fprintf(f, "%s,%lu,%d\n", Paths[i].name, Paths[i].calls ? (unsigned long)Paths[i].max : Paths[i].baseline,
+                    Paths[i].threshold);
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static const char *status(const Path_t *p)
+{
+    if (!p->calls)
+    {
+        return p->baseline || p->addr ? "missing" : "absent";
+    }
+    if (!p->baseline)
+    {
+        return "unrecorded";
+    }
+    if (p->max * 100 > (uint64_t)p->baseline * (uint64_t)(100 + p->threshold))
+    {
+        return "FAIL";
+    }
+    return "ok";
+}
+
+int main(int argc, char **argv)
+{
+    const char *baseline = 0, *out = 0, *keys = "11111111122121";
+    double seconds = 45;
+    int write = 0, failed = 0, state, held = 0, opt;
+    uint64_t end, next_key = KEY_PERIOD;
+    uint32_t quiet = 0;
+    uint32_t flags = 0;
+    elf_firmware_t fw;
+    FILE *f;
+
+    while ((opt = getopt(argc, argv, "b:o:k:s:w")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            baseline = optarg;
+            break;
+        case 'o':
+            out = optarg;
+            break;
+        case 'k':
+            keys = optarg;
+            break;
+        case 's':
+            seconds = strtod(optarg, 0);
+            break;
+        case 'w':
+            write = 1;
+            break;
+        default:
+            optind = argc;
+            break;
+        }
+    }
+    if (optind != argc - 1 || (write && !baseline) || strspn(keys, "1234") != strlen(keys))
+    {
+        fprintf(stderr, "usage: %s [-b baseline.csv [-w]] [-o results.csv] [-k keys] [-s seconds] firmware.elf\n",
+                argv[0]);
+        return 2;
+    }
+    for (size_t i = 0; i < PATHS; i++)
+    {
+        Paths[i].threshold = DEFAULT_THRESHOLD;
+    }
+    if (baseline && read_baseline(baseline) && !write)
+    {
+        fprintf(stderr, "avrbench: cannot read %s\n", baseline);
+        return 2;
+    }
+
+    memset(&fw, 0, sizeof(fw));
+    if (elf_read_firmware(argv[optind], &fw) || read_symbols(argv[optind]))
+    {
+        fprintf(stderr, "avrbench: cannot read %s\n", argv[optind]);
+        return 2;
+    }
+    for (size_t i = 0; i < PATHS; i++)
+    {
+        Paths[i].addr = symbol(Paths[i].symbol);
+        if (Paths[i].kind == TRACE && Paths[i].addr)
+        {
+            Entry[Paths[i].addr >> 1] = (uint8_t)(i + 1);
+        }
+    }
+    for (size_t i = 0; i < sizeof(Quiet) / sizeof(Quiet[0]) && !quiet; i++)
+    {
+        quiet = symbol(Quiet[i]);
+    }
+
+    Avr = avr_make_mcu_by_name("atmega328p");
+    if (!Avr || avr_init(Avr))
+    {
+        fprintf(stderr, "avrbench: no atmega328p in this simavr\n");
+        return 2;
+    }
+    avr_load_firmware(Avr, &fw);
+    Avr->frequency = F_CPU;
+    Avr->vcc = Avr->avcc = Avr->aref = 5000;
+    Avr->sleep = no_sleep;
+    Avr->log = LOG_ERROR;
+    // the telemetry is binary, and polling the USART must not sleep the host
+    avr_ioctl(Avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~(AVR_UART_FLAG_STDIO | AVR_UART_FLAG_POOL_SLEEP);
+    avr_ioctl(Avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+    for (size_t i = 0; i < sizeof(Inputs) / sizeof(Inputs[0]); i++)
+    {
+        avr_raise_irq(avr_io_getirq(Avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0 + Inputs[i].channel), Inputs[i].mv);
+    }
+    for (int k = 1; k <= 4; k++)
+    {
+        key(k, 0);
+    }
+
+    end = (uint64_t)(seconds * F_CPU);
+    do
+    {
+        if (Avr->cycle >= next_key)
+        {
+            if (held)
+            {
+                key(held, 0);
+                held = 0;
+                next_key += KEY_PERIOD - KEY_HOLD;
+            }
+            else if (*keys)
+            {
+                held = *keys++ - '0';
+                key(held, 1);
+                next_key += KEY_HOLD;
+            }
+            else
+            {
+                next_key = UINT64_MAX;
+            }
+        }
+        state = step();
+        if (state == cpu_Done || state == cpu_Crashed)
+        {
+            fprintf(stderr, "avrbench: firmware stopped at pc 0x%x after %.3fs\n", (unsigned)Avr->pc,
+                    (double)Avr->cycle / F_CPU);
+            return 2;
+        }
+    } while (Avr->cycle < end || (quiet && Avr->pc != quiet));
+
+    for (size_t i = 0; i < PATHS && quiet; i++)
+    {
+        if (Paths[i].kind == CALL && Paths[i].addr && call(&Paths[i]))
+        {
+            fprintf(stderr, "avrbench: firmware stopped in %s\n", Paths[i].symbol);
+            return 2;
+        }
+    }
+
+    f = out ? fopen(out, "w") : 0;
+    if (out && !f)
+    {
+        fprintf(stderr, "avrbench: cannot write %s\n", out);
+        return 2;
+    }
+    if (f)
+    {
+        fprintf(f, "path,symbol,calls,min,mean,max,baseline,threshold_pct,status\n");
+    }
+    printf("%-18s %8s %8s %10s %8s %8s  %s\n", "path", "calls", "min", "mean", "max", "baseline", "status");
+    for (size_t i = 0; i < PATHS; i++)
+    {
+        Path_t *p = &Paths[i];
+        double mean = p->calls ? (double)p->sum / p->calls : 0;
+        const char *s = status(p);
+
+        if (!p->name)
+        {
+            continue;
+        }
+        failed |= !strcmp(s, "FAIL") || !strcmp(s, "missing") || (baseline && !strcmp(s, "unrecorded"));
+        printf("%-18s %8lu %8lu %10.1f %8lu %8lu  %s\n", p->name, p->calls, (unsigned long)p->min, mean,
+               (unsigned long)p->max, p->baseline, s);
+        if (f)
+        {
+            fprintf(f, "%s,%s,%lu,%lu,%.1f,%lu,%lu,%d,%s\n", p->name, p->symbol, p->calls, (unsigned long)p->min,
+                    mean, (unsigned long)p->max, p->baseline, p->threshold, s);
+        }
+    }
+    if (f)
+    {
+        fclose(f);
+    }
+    printf("%.1fs of firmware time, %llu cycles\n", (double)Avr->cycle / F_CPU, (unsigned long long)Avr->cycle);
+
+    if (write)
+    {
+        if (write_baseline(baseline))
+        {
+            fprintf(stderr, "avrbench: cannot write %s\n", baseline);
+            return 2;
+        }
+        return 0;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,370 @@
+/* BED EXIT REPLAY
+Feeds synthetic load cell traces through the bed exit detector of
+src/bedexit.c at each sensitivity, and through the old rule (weight above
+10 kg, decided each 100ms) for comparison. Samples come at the firmware's
+rate, one per load cell visit of the ADC scan (every third 16.384ms tick,
+see ADC.h), and reach the detector on the next tick with TASK_Exit. They
+carry load cell noise, patient movement and the firmware's whole kilograms.
+
+Scenarios, each on its own random patient (45 to 130 kg):
+  exit     the patient gets up, the weight ramps down in 0.3 to 2s
+  entry    the patient gets in, the weight ramps up in 0.3 to 2s
+  roll     turning or sitting up, 20 to 40% of the weight off for 0.5 to 3s
+  visitor  someone sits on the bed for 20 to 60s and gets up
+  lean     3 to 9 kg leaned on the empty bed for 2 to 10s
+
+The latency of an exit or entry is taken from the moment the true load
+crosses half the patient's weight. A false event is any event in a roll,
+visitor or lean trace, or one before the exit or entry starts.
+
+  cc -O2 -Iinclude -o bedexit_replay tools/bedexit_replay.c src/bedexit.c -lm
+  ./bedexit_replay -n 5000         5000 traces per scenario
+  ./bedexit_replay -m 5            restless patients (1.5 kg of movement by default), shows
+                                   what the higher sensitivities cost in false exits
+
+Exits with 1 if the default sensitivity (BED_EXIT_SENSITIVITY) detects less
+than 99% of the exits within 200ms, raises a false event or misses one.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bed.h"
+#include "bedexit.h"
+
+#define TICK_S 0.016384       // timer0 overflow
+#define SAMPLE_S (3 * TICK_S) // load cell visits, between every two other channels
+#define DECIDE_S TICK_S       // converted after the tick's tasks, TASK_Exit sees it next tick
+#define RULE_S (6 * TICK_S)   // TASK_Sense
+#define WARMUP_S 10.0         // occupied traces start with the patient getting in
+#define AFTER_S 10.0          // trace continues this long after the scenario
+#define BUDGET_S 0.2
+#define NOISE_KG 0.4          // load cell, mean of 64 conversions
+#define MOTION_TAU_S 0.3      // patient movement correlation
+
+// SCENARIOS
+#define SC_EXIT 0
+#define SC_ENTRY 1
+#define SC_ROLL 2
+#define SC_VISITOR 3
+#define SC_LEAN 4
+#define SCENARIOS 5
+
+#define DETECTORS (BEDEXIT_LEVELS + 1) // the last one is the old rule
+
+static double Motion_Kg = 1.5; // patient movement
+
+static const char *const Scenario_Names[SCENARIOS] = {"exit", "entry", "roll", "visitor", "lean"};
+static const char *const Detector_Names[DETECTORS] = {"low", "medium", "high", "old rule"};
+
+typedef struct
+{
+    unsigned rng;
+    int scenario;
+    double patient; // kg
+    double start;   // s, scenario start
+    double ramp;    // s
+    double hold;    // s, dip or visit length
+    double extra;   // kg: residual after an exit, dip depth, visitor, lean
+    double phase;   // s, first sample
+    double end;     // s
+    double truth;   // s, half weight crossing of an exit or entry
+} Trace_t;
+
+typedef struct
+{
+    double *latency[2]; // exit, entry
+    unsigned long count[2];
+    unsigned long within[2];
+    unsigned long missed[2];
+    unsigned long false_events[SCENARIOS];
+} Result_t;
+
+static unsigned xorshift(unsigned *s)
+{
+    unsigned x = *s;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+static double uniform(unsigned *s)
+{
+    return (xorshift(s) >> 8) * (1.0 / 16777216.0);
+}
+
+static double gauss(unsigned *s)
+{
+    double u = uniform(s) + 1e-12;
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * uniform(s));
+}
+
+static void trace_init(Trace_t *t, int scenario, unsigned seed)
+{
+    memset(t, 0, sizeof(*t));
+    t->rng = 2463534242u ^ (seed * 2654435761u) ^ ((unsigned)scenario << 24);
+    if (!t->rng)
+    {
+        t->rng = 1;
+    }
+    t->scenario = scenario;
+    t->patient = 45 + 85 * uniform(&t->rng);
+    t->start = WARMUP_S + 2 * uniform(&t->rng);
+    t->phase = SAMPLE_S * uniform(&t->rng);
+    t->ramp = 0.3 + 1.7 * uniform(&t->rng);
+    switch (scenario)
+    {
+    case SC_EXIT:
+        t->extra = 3 * uniform(&t->rng); // hand left on the rail
+        t->truth = t->start + t->ramp * (t->patient / 2) / (t->patient - t->extra);
+        t->end = t->start + t->ramp + AFTER_S;
+        break;
+    case SC_ENTRY:
+        t->truth = t->start + t->ramp / 2;
+        t->end = t->start + t->ramp + AFTER_S;
+        break;
+    case SC_ROLL:
+        t->ramp = 0.2 + 0.3 * uniform(&t->rng);
+        t->hold = 0.5 + 2.5 * uniform(&t->rng);
+        t->extra = t->patient * (0.2 + 0.2 * uniform(&t->rng));
+        t->end = t->start + 2 * t->ramp + t->hold + AFTER_S;
+        break;
+    case SC_VISITOR:
+        t->ramp = 0.5 + uniform(&t->rng);
+        t->hold = 20 + 40 * uniform(&t->rng);
+        t->extra = 50 + 50 * uniform(&t->rng);
+        t->end = t->start + 2 * t->ramp + t->hold + AFTER_S;
+        break;
+    case SC_LEAN:
+        t->ramp = 0.3;
+        t->hold = 2 + 8 * uniform(&t->rng);
+        t->extra = 3 + 6 * uniform(&t->rng);
+        t->end = t->start + 2 * t->ramp + t->hold + AFTER_S;
+        break;
+    }
+}
+
+// 0 before the ramp, 1 at its end
+static double ramp(double x, double start, double len)
+{
+    x = (x - start) / len;
+    return x < 0 ? 0 : (x > 1 ? 1 : x);
+}
+
+// trapezoid pulse of the trace's ramp and hold
+static double pulse(const Trace_t *t, double x)
+{
+    return ramp(x, t->start, t->ramp) - ramp(x, t->start + t->ramp + t->hold, t->ramp);
+}
+
+// true load on the cell
+static double load(const Trace_t *t, double x)
+{
+    double in = t->patient * ramp(x, 0.5, 1.0); // occupied traces start with an entry
+
+    switch (t->scenario)
+    {
+    case SC_EXIT:
+        return t->patient - (t->patient - t->extra) * ramp(x, t->start, t->ramp);
+    case SC_ENTRY:
+        return t->patient * ramp(x, t->start, t->ramp);
+    case SC_ROLL:
+        return in - t->extra * pulse(t, x);
+    case SC_VISITOR:
+        return in + t->extra * pulse(t, x);
+    default:
+        return t->extra * pulse(t, x);
+    }
+}
+
+// next sample: the load, movement while someone is on the bed, noise, whole kg like LOADCELL_ReadWeight
+static u16 sample(Trace_t *t, double x, double *motion)
+{
+    double kg = load(t, x);
+
+    *motion += (Motion_Kg * sqrt(2 * SAMPLE_S / MOTION_TAU_S) * gauss(&t->rng) - *motion) * (SAMPLE_S / MOTION_TAU_S);
+    if (kg > BEDEXIT_ENTRY_KG)
+    {
+        kg += *motion;
+    }
+    kg += NOISE_KG * gauss(&t->rng);
+    return kg < 0 ? 0 : (u16)lround(kg);
+}
+
+// an event at time x, the entry of an occupied trace's first seconds is not counted
+static void record(Result_t *r, const Trace_t *t, double x, u8 event, int *seen, int *warm)
+{
+    int kind = event == BEDEXIT_EV_EXIT ? 0 : 1;
+    int occupied = t->scenario == SC_EXIT || t->scenario == SC_ROLL || t->scenario == SC_VISITOR;
+    int expected = (t->scenario == SC_EXIT && kind == 0) || (t->scenario == SC_ENTRY && kind == 1);
+
+    if (occupied && kind == 1 && x < t->start && !*warm)
+    {
+        *warm = 1;
+        return;
+    }
+    if (!expected || x < t->start || *seen)
+    {
+        r->false_events[t->scenario]++;
+        return;
+    }
+    *seen = 1;
+    r->latency[kind][r->count[kind]++] = x - t->truth;
+    if (x - t->truth <= BUDGET_S)
+    {
+        r->within[kind]++;
+    }
+}
+
+static void run(Result_t *r, int det, int scenario, unsigned seed)
+{
+    Trace_t t;
+    BEDEXIT_t d;
+    double motion = 0, rule = 0;
+    int seen = 0, warm = 0, occupied = 0;
+    u16 w = 0;
+
+    trace_init(&t, scenario, seed);
+    BEDEXIT_Init(&d, det < BEDEXIT_LEVELS ? det : 0);
+    for (double x = t.phase; x < t.end; x += SAMPLE_S)
+    {
+        if (det == BEDEXIT_LEVELS)
+        {
+            // the old rule looks at the latest sample each 100ms
+            for (; rule < x; rule += RULE_S)
+            {
+                if ((w > BEDEXIT_ENTRY_KG) != occupied)
+                {
+                    occupied ^= 1;
+                    record(r, &t, rule, occupied ? BEDEXIT_EV_ENTRY : BEDEXIT_EV_EXIT, &seen, &warm);
+                }
+            }
+            w = sample(&t, x, &motion);
+            continue;
+        }
+        w = sample(&t, x, &motion);
+        u8 event = BEDEXIT_Step(&d, w);
+        if (event != BEDEXIT_EV_NONE)
+        {
+            record(r, &t, x + DECIDE_S, event, &seen, &warm);
+        }
+    }
+    if ((scenario == SC_EXIT || scenario == SC_ENTRY) && !seen)
+    {
+        r->missed[scenario == SC_EXIT ? 0 : 1]++;
+    }
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double quantile(double *v, unsigned long n, double p)
+{
+    if (!n)
+    {
+        return 0;
+    }
+    return v[(unsigned long)(p * (n - 1) + 0.5)];
+}
+
+static unsigned long false_events(const Result_t *r)
+{
+    unsigned long n = 0;
+
+    for (int s = 0; s < SCENARIOS; s++)
+    {
+        n += r->false_events[s];
+    }
+    return n;
+}
+
+static void report(Result_t *r, const char *name)
+{
+    static const char *const kinds[2] = {"exit", "entry"};
+
+    printf("%-9s", name);
+    for (int k = 0; k < 2; k++)
+    {
+        double *v = r->latency[k];
+        unsigned long n = r->count[k];
+        qsort(v, n, sizeof(*v), cmp_double);
+        printf("  %-5s p50 %4.0f p99 %4.0f max %4.0f ms %5.1f%% in 200ms %lu missed", kinds[k],
+               quantile(v, n, 0.5) * 1000, quantile(v, n, 0.99) * 1000, n ? v[n - 1] * 1000 : 0,
+               n ? 100.0 * r->within[k] / n : 0.0, r->missed[k]);
+        if (k == 0)
+        {
+            printf("\n         ");
+        }
+    }
+    printf("\n          false events");
+    for (int s = 0; s < SCENARIOS; s++)
+    {
+        printf(" %s %lu", Scenario_Names[s], r->false_events[s]);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    Result_t r[DETECTORS];
+    unsigned long n = 2000;
+    int opt, fail;
+
+    while ((opt = getopt(argc, argv, "n:m:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            n = strtoul(optarg, 0, 10);
+            break;
+        case 'm':
+            Motion_Kg = strtod(optarg, 0);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n traces per scenario] [-m movement kg]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!n)
+    {
+        fprintf(stderr, "traces must be above 0\n");
+        return 2;
+    }
+
+    printf("bedexit_replay: %lu traces per scenario (%s", n, Scenario_Names[0]);
+    for (int s = 1; s < SCENARIOS; s++)
+    {
+        printf(", %s", Scenario_Names[s]);
+    }
+    printf("), %.1f kg movement, latency from the half weight crossing\n", Motion_Kg);
+    for (int det = 0; det < DETECTORS; det++)
+    {
+        memset(&r[det], 0, sizeof(r[det]));
+        r[det].latency[0] = malloc(sizeof(double) * n);
+        r[det].latency[1] = malloc(sizeof(double) * n);
+        for (int s = 0; s < SCENARIOS; s++)
+        {
+            for (unsigned long i = 0; i < n; i++)
+            {
+                run(&r[det], det, s, (unsigned)i + 1);
+            }
+        }
+        report(&r[det], Detector_Names[det]);
+    }
+
+    fail = r[BED_EXIT_SENSITIVITY].within[0] < 0.99 * n || false_events(&r[BED_EXIT_SENSITIVITY]) ||
+           r[BED_EXIT_SENSITIVITY].missed[0] || r[BED_EXIT_SENSITIVITY].missed[1];
+    printf("%s: default sensitivity %s\n", fail ? "FAIL" : "PASS", Detector_Names[BED_EXIT_SENSITIVITY]);
+    for (int det = 0; det < DETECTORS; det++)
+    {
+        free(r[det].latency[0]);
+        free(r[det].latency[1]);
+    }
+    return fail;
+}
@@ -0,0 +1,169 @@
+/* BED SNAPSHOT STRESS TEST
+One thread publishes bed states as fast as it can with BED_Publish, the
+others take copies with BED_Snapshot and check that every copy is a state
+that was published as a whole. All fields of a published state are made
+from one counter, a copy mixing two states fails the check.
+
+  cc -O2 -pthread -DHAL_NATIVE -Iinclude -o bedsnap_stress tools/bedsnap_stress.c src/bed.c src/bedexit.c src/heater.c src/sensor.c
+  ./bedsnap_stress -t 3 -s 5       3 readers for 5 seconds, must report 0 torn
+  ./bedsnap_stress -u              plain copies without the sequence, shows the test does catch tears
+
+Exits with 1 if a torn copy was seen.
+*/
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bed.h"
+
+static BED_Shared_t Shared;
+static atomic_int Stop;
+static int Unsafe;
+
+typedef struct
+{
+    pthread_t thread;
+    unsigned long copies, torn;
+    double ns;
+} Reader_t;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// every field from the counter n
+static void make_state(BED_t *b, u16 n)
+{
+    b->weight = n;
+    b->occupancy = (u16)(n + 0x1234);
+    b->body = (temp_dC_t)(n * 3);
+    b->room = (temp_dC_t)(n ^ 0x5555);
+    b->heater.output = (u16)(n * 7);
+    b->heater_threshold = (u16)(n + 1);
+    b->heater_enable = n & 1;
+    b->heater_state = (n >> 1) & 1;
+    b->lamp_enable = (n >> 2) & 1;
+    b->lamp_state = (n >> 3) & 1;
+    b->mode_new = (n >> 4) & 1;
+    b->alarms = (u8)(n >> 8);
+}
+
+static int consistent(const BED_View_t *v)
+{
+    u16 n = v->weight;
+
+    return v->occupancy == (u16)(n + 0x1234) && v->body == (temp_dC_t)(n * 3) && v->room == (temp_dC_t)(n ^ 0x5555) &&
+           v->heater_duty == (u16)(n * 7) && v->heater_threshold == (u16)(n + 1) && v->heater_enable == (n & 1) &&
+           v->heater_state == ((n >> 1) & 1) && v->lamp_enable == ((n >> 2) & 1) &&
+           v->lamp_state == ((n >> 3) & 1) && v->mode == ((n >> 4) & 1) && v->alarms == (u8)(n >> 8);
+}
+
+static void *writer(void *arg)
+{
+    unsigned long *publishes = arg;
+    BED_t b;
+    u16 n = 0;
+
+    memset(&b, 0, sizeof(b));
+    while (!atomic_load_explicit(&Stop, memory_order_relaxed))
+    {
+        make_state(&b, ++n);
+        BED_Publish(&b, &Shared);
+        (*publishes)++;
+    }
+    return 0;
+}
+
+static void *reader(void *arg)
+{
+    Reader_t *r = arg;
+    BED_View_t v;
+    double t0 = now_ns();
+
+    while (!atomic_load_explicit(&Stop, memory_order_relaxed))
+    {
+        if (Unsafe)
+        {
+            memcpy(&v, (const void *)&Shared.view, sizeof(v));
+        }
+        else
+        {
+            BED_Snapshot(&Shared, &v);
+        }
+        r->copies++;
+        if (!consistent(&v))
+        {
+            r->torn++;
+        }
+    }
+    r->ns = now_ns() - t0;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned readers = 2;
+    double seconds = 2;
+    unsigned long publishes = 0, copies = 0, torn = 0;
+    double ns = 0;
+    pthread_t w;
+    Reader_t *r;
+    BED_t b;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:s:u")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            readers = (unsigned)strtoul(optarg, 0, 10);
+            break;
+        case 's':
+            seconds = strtod(optarg, 0);
+            break;
+        case 'u':
+            Unsafe = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t readers] [-s seconds] [-u]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!readers)
+    {
+        readers = 1;
+    }
+
+    memset(&b, 0, sizeof(b));
+    make_state(&b, 0);
+    BED_Publish(&b, &Shared);
+    r = calloc(readers, sizeof(*r));
+    pthread_create(&w, 0, writer, &publishes);
+    for (unsigned i = 0; i < readers; i++)
+    {
+        pthread_create(&r[i].thread, 0, reader, &r[i]);
+    }
+    usleep((useconds_t)(seconds * 1e6));
+    atomic_store(&Stop, 1);
+    pthread_join(w, 0);
+    for (unsigned i = 0; i < readers; i++)
+    {
+        pthread_join(r[i].thread, 0);
+        copies += r[i].copies;
+        torn += r[i].torn;
+        ns += r[i].ns;
+    }
+
+    printf("%s: %lu publishes, %lu copies by %u readers, %lu torn, %.1f ns per copy\n",
+           Unsafe ? "plain copy" : "BED_Snapshot", publishes, copies, readers, torn, copies ? ns / copies : 0.0);
+    free(r);
+    return torn ? 1 : 0;
+}
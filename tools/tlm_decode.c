@@ -0,0 +1,293 @@
+/* TELEMETRY DECODER FOR LINUX
+Reads the USART telemetry stream (see include/telemetry.h) from a serial
+device, a pty or a capture file, checks each frame and prints one line per
+record, with a summary of frames, CRC errors, lost records and bandwidth at
+the end (EOF or Ctrl-C).
+
+  cc -O2 -Iinclude -o tlm_decode tools/tlm_decode.c src/crc.c
+  ./tlm_decode /dev/ttyUSB0          live from the board, 115200 8N1
+  HAL_SIM_UART=tlm.bin .pio/build/native/program && ./tlm_decode tlm.bin
+  socat pty,raw,echo=0,link=/tmp/bed pty,raw,echo=0,link=/tmp/host &
+  HAL_SIM_UART=/tmp/bed .pio/build/native/program & ./tlm_decode /tmp/host
+
+-q prints the summary only.
+*/
+#define _DEFAULT_SOURCE // cfmakeraw
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "crc.h"
+#include "telemetry.h"
+
+#define TICK_S 0.016384 // timer0 overflow
+#define RAW_MAX 256     // longest frame accepted before the delimiter
+
+static volatile sig_atomic_t Stop = 0;
+
+static struct
+{
+    unsigned long bytes, frames, bad_crc, bad_frame, lost;
+    unsigned long records[TLM_REC_STATS + 1];
+    unsigned long type_bytes[TLM_REC_STATS + 1];
+    double first, last; // record time, s
+    int have_seq;
+    unsigned char seq;
+    unsigned long ticks; // unwrapped 16 bit tick
+    int have_tick;
+} St;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    Stop = 1;
+}
+
+static int open_input(const char *path)
+{
+    struct termios tio;
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+
+    if (fd < 0)
+    {
+        perror(path);
+        exit(1);
+    }
+    if (isatty(fd))
+    {
+        // raw 8N1 at the firmware rate, ignored by ptys
+        if (tcgetattr(fd, &tio) == 0)
+        {
+            cfmakeraw(&tio);
+            cfsetispeed(&tio, B115200);
+            cfsetospeed(&tio, B115200);
+            tio.c_cflag |= CLOCAL | CREAD;
+            tio.c_cc[VMIN] = 1;
+            tio.c_cc[VTIME] = 0;
+            tcsetattr(fd, TCSANOW, &tio);
+        }
+    }
+    return fd;
+}
+
+// COBS decode into dst, returns the decoded length or -1
+static int cobs_decode(const unsigned char *src, int len, unsigned char *dst)
+{
+    int i = 0, n = 0;
+
+    while (i < len)
+    {
+        int code = src[i++];
+        if (code == 0 || i + code - 1 > len)
+        {
+            return -1;
+        }
+        for (int k = 1; k < code; k++)
+        {
+            dst[n++] = src[i++];
+        }
+        if (code < 0xff && i < len)
+        {
+            dst[n++] = 0;
+        }
+    }
+    return n;
+}
+
+static int get16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static void record(const unsigned char *f, int len, int frame_bytes, int quiet)
+{
+    unsigned char type = f[0], seq = f[1];
+    unsigned tick = get16(&f[2]);
+    const unsigned char *p = &f[TLM_HEADER_SIZE];
+    int plen = len - TLM_HEADER_SIZE - 2;
+    double t;
+
+    // tick and sequence gaps
+    if (St.have_tick)
+    {
+        St.ticks += (unsigned short)(tick - (St.ticks & 0xffff));
+    }
+    else
+    {
+        St.ticks = tick;
+        St.have_tick = 1;
+    }
+    if (St.have_seq && seq != (unsigned char)(St.seq + 1))
+    {
+        St.lost += (unsigned char)(seq - St.seq - 1);
+    }
+    St.seq = seq;
+    St.have_seq = 1;
+
+    t = St.ticks * TICK_S;
+    if (!St.frames)
+    {
+        St.first = t;
+    }
+    St.last = t;
+    St.frames++;
+    if (type <= TLM_REC_STATS)
+    {
+        St.records[type]++;
+        St.type_bytes[type] += frame_bytes;
+    }
+    if (quiet)
+    {
+        return;
+    }
+
+    printf("%10.3f %3u ", t, seq);
+    switch (type)
+    {
+    case TLM_REC_SAMPLE:
+        if (plen < 11)
+            break;
+        printf("sample body %.1f room %.1f weight %d raw %d duty %d%s%s%s%s%s\n", (short)get16(&p[0]) / 10.0,
+               (short)get16(&p[2]) / 10.0, get16(&p[4]), get16(&p[6]), get16(&p[8]),
+               (p[10] & TLM_FLAG_HEATER) ? " heater" : "", (p[10] & TLM_FLAG_LAMP) ? " lamp" : "",
+               (p[10] & TLM_FLAG_FEVER) ? " FEVER" : "", (p[10] & TLM_FLAG_WEIGHT) ? " WEIGHT" : "",
+               (p[10] & TLM_FLAG_EXIT) ? " EXIT" : "");
+        return;
+    case TLM_REC_STATE:
+        if (plen < 6)
+            break;
+        printf("state mode %s heater %s at %d C lamp %s/%s alarms 0x%02x\n", p[0] ? "sleep" : "sit",
+               p[1] ? "on" : "off", p[2], p[3] ? "enabled" : "disabled", p[4] ? "on" : "off", p[5]);
+        return;
+    case TLM_REC_ALARM:
+        if (plen < 2)
+            break;
+        printf("alarm slot %d %s\n", p[0], p[1] ? "raised" : "cleared");
+        return;
+    case TLM_REC_STATS:
+        if (plen < 5)
+            break;
+        printf("stats sent %d dropped %d ring low %d\n", get16(&p[0]), get16(&p[2]), p[4]);
+        return;
+    }
+    printf("type 0x%02x, %d payload bytes\n", type, plen);
+}
+
+static void frame(const unsigned char *raw, int len, int quiet)
+{
+    unsigned char f[RAW_MAX];
+    int n = cobs_decode(raw, len, f);
+
+    if (n < TLM_HEADER_SIZE + 2)
+    {
+        St.bad_frame++;
+        return;
+    }
+    if (CRC16_Block(CRC16_INIT, f, (unsigned char)(n - 2)) != get16(&f[n - 2]))
+    {
+        St.bad_crc++;
+        return;
+    }
+    record(f, n, len + 1, quiet);
+}
+
+static void summary(void)
+{
+    static const char *const names[] = {"?", "sample", "state", "alarm", "stats"};
+    double span = St.last - St.first;
+
+    fprintf(stderr, "\n%lu bytes, %lu frames, %lu crc errors, %lu bad frames, %lu lost records\n", St.bytes, St.frames,
+            St.bad_crc, St.bad_frame, St.lost);
+    for (int i = 1; i <= TLM_REC_STATS; i++)
+    {
+        fprintf(stderr, "%-7s %8lu records %8lu bytes", names[i], St.records[i], St.type_bytes[i]);
+        if (span > 0)
+        {
+            fprintf(stderr, "  %.1f B/s", St.type_bytes[i] / span);
+        }
+        fprintf(stderr, "\n");
+    }
+    if (span > 0)
+    {
+        fprintf(stderr, "%.1f s of records, %.1f B/s\n", span, St.bytes / span);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned char buf[512], raw[RAW_MAX];
+    int fd, len = 0, quiet = 0, overrun = 0;
+    const char *path = 0;
+    struct sigaction sa;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-q"))
+        {
+            quiet = 1;
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+    if (!path)
+    {
+        fprintf(stderr, "usage: %s [-q] device|pty|file\n", argv[0]);
+        return 2;
+    }
+    fd = open_input(path);
+    // no SA_RESTART, a signal ends the blocking read
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, 0);
+    sigaction(SIGTERM, &sa, 0);
+    setvbuf(stdout, 0, _IOLBF, 0);
+
+    while (!Stop)
+    {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break; // EOF, or the other side of the pty closed
+        }
+        St.bytes += n;
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (buf[i] == 0)
+            {
+                // an overlong frame is dropped whole, a stream picked up mid frame fails the crc
+                if (overrun)
+                {
+                    St.bad_frame++;
+                }
+                else if (len)
+                {
+                    frame(raw, len, quiet);
+                }
+                len = 0;
+                overrun = 0;
+            }
+            else if (len < RAW_MAX)
+            {
+                raw[len++] = buf[i];
+            }
+            else
+            {
+                overrun = 1;
+            }
+        }
+    }
+    summary();
+    close(fd);
+    return 0;
+}
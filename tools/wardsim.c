@@ -0,0 +1,546 @@
+/* WARD SIMULATOR
+Runs the bed logic of src/bed.c for thousands of beds on a work stealing
+thread pool, with synthetic patients: weight with the patient leaving and
+visitors sitting down, body temperature with fever episodes, and a room
+heated by the bed's heater relay. Each step is 100ms of ward time, all beds
+step together in rounds of a few steps.
+
+Beds are split into tasks of -c beds. At the start of a round each worker
+pushes its own share of the tasks on its deque (the same beds each round,
+so their state stays in that core's cache), works through it from the
+bottom and steals from the top of other deques when it runs dry.
+
+  cc -O2 -pthread -DHAL_NATIVE -Iinclude -o wardsim tools/wardsim.c src/bed.c src/bedexit.c src/heater.c src/sensor.c -lm
+  ./wardsim -b 4096 -t 8 -s 600     4096 beds, 8 threads, 10 minutes of ward time
+  ./wardsim -b 4096 -t 8 -S         same for 1, 2, 4 and 8 threads
+
+Reported: bed steps per second (one step is one pass of the 100ms tasks
+with the 1s task every 10th), the time to decide one bed step, the time
+from the start of a round until a bed's decisions for it are done, and
+the alarms raised. The alarm counts only depend on the bed seeds, they
+are the same for any thread count.
+*/
+#define _GNU_SOURCE // sched_yield
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "alarm.h"
+#include "bed.h"
+
+#define STEP_S 0.1
+#define STEPS_PER_CONTROL 10 // BED_Control each second
+#define HIST_SUB 4           // histogram buckets per octave
+#define HIST_BUCKETS (40 * HIST_SUB)
+#define CACHE_LINE 64
+
+// SYNTHETIC PATIENT AND ROOM
+#define ROOM_TAU_S 600.0
+#define SENSOR_TAU_S 20.0
+#define HEATER_RISE 12.0
+#define LEAVE_PER_STEP (1.0 / (3600 / STEP_S))   // patient gets up about once an hour
+#define VISIT_PER_STEP (1.0 / (7200 / STEP_S))   // someone sits on the bed every 2 hours
+#define FEVER_PER_STEP (1.0 / (21600 / STEP_S))  // a fever episode every 6 hours
+#define MODE_PER_SECOND (1.0 / 1800)             // sit/sleep toggled every half hour
+#define C_PER_CODE (500.0 / 1024)                // LM35 on the 5V 10 bit ADC
+
+typedef struct
+{
+    BED_t bed;
+    unsigned rng;
+    float patient, visitor; // kg on the bed
+    unsigned away, visit;   // steps left
+    float base_temp, fever; // C, fever is the current rise
+    unsigned fever_steps;   // steps left in the episode
+    float fever_peak;
+    float ambient, room, sensor; // C
+} Bed_t;
+
+typedef struct
+{
+    unsigned long steps, tasks, steals;
+    unsigned long alarms[ALARM_SLOTS];
+    unsigned long service[HIST_BUCKETS]; // ns per bed step
+    unsigned long latency[HIST_BUCKETS]; // ns from the round start to the bed's last step
+} Stats_t;
+
+/* CHASE-LEV DEQUE
+The owner pushes and takes at the bottom, thieves steal at the top; only
+the last task is contended and settled with a CAS on top. Indices only
+grow, the ring holds every task of a round.
+*/
+typedef struct
+{
+    _Alignas(CACHE_LINE) atomic_long top;
+    _Alignas(CACHE_LINE) atomic_long bottom;
+    atomic_int *buf;
+    long mask;
+} Deque_t;
+
+#define DQ_EMPTY -1
+#define DQ_ABORT -2
+
+typedef struct
+{
+    _Alignas(CACHE_LINE) Deque_t dq;
+    Stats_t st;
+    pthread_t thread;
+    unsigned id, rng;
+} Worker_t;
+
+static struct
+{
+    Bed_t *beds;
+    unsigned nbeds, chunk, ntasks;
+    unsigned nthreads;
+    unsigned long steps, per_round; // run length and steps per round
+    Worker_t *workers;
+    pthread_barrier_t barrier;
+    _Alignas(CACHE_LINE) atomic_long remaining; // tasks left in the round
+    unsigned long round_first;                  // first step of the round
+    unsigned round_steps;
+    struct timespec round_start;
+    int done;
+} W;
+
+static unsigned xorshift(unsigned *s)
+{
+    unsigned x = *s;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+static double uniform(unsigned *s)
+{
+    return (xorshift(s) >> 8) * (1.0 / 16777216.0);
+}
+
+static long ns_since(const struct timespec *a, const struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) * 1000000000L + (b->tv_nsec - a->tv_nsec);
+}
+
+static unsigned hist_bucket(unsigned long ns)
+{
+    unsigned oct = 0;
+    unsigned b;
+
+    if (ns < HIST_SUB)
+    {
+        return (unsigned)ns;
+    }
+    while ((ns >> oct) >= 2 * HIST_SUB)
+    {
+        oct++;
+    }
+    b = (oct + 1) * HIST_SUB + (unsigned)((ns >> oct) - HIST_SUB);
+    return b < HIST_BUCKETS ? b : HIST_BUCKETS - 1;
+}
+
+static unsigned long hist_upper(unsigned b)
+{
+    unsigned oct = b / HIST_SUB;
+
+    if (oct == 0)
+    {
+        return b;
+    }
+    return (unsigned long)(HIST_SUB + b % HIST_SUB + 1) << (oct - 1);
+}
+
+static void dq_init(Deque_t *d, long cap)
+{
+    atomic_init(&d->top, 0);
+    atomic_init(&d->bottom, 0);
+    d->buf = calloc(cap, sizeof(*d->buf));
+    d->mask = cap - 1;
+}
+
+static void dq_push(Deque_t *d, int x)
+{
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    atomic_store_explicit(&d->buf[b & d->mask], x, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+}
+
+static int dq_take(Deque_t *d)
+{
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    long t;
+    int x = DQ_EMPTY;
+
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    if (t <= b)
+    {
+        x = atomic_load_explicit(&d->buf[b & d->mask], memory_order_relaxed);
+        if (t == b)
+        {
+            // last task, race the thieves for it
+            if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst,
+                                                         memory_order_relaxed))
+            {
+                x = DQ_EMPTY;
+            }
+            atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        }
+    }
+    else
+    {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return x;
+}
+
+static int dq_steal(Deque_t *d)
+{
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    long b;
+    int x;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b)
+    {
+        return DQ_EMPTY;
+    }
+    x = atomic_load_explicit(&d->buf[t & d->mask], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+    {
+        return DQ_ABORT;
+    }
+    return x;
+}
+
+static void bed_init(Bed_t *p, unsigned i)
+{
+    memset(p, 0, sizeof(*p));
+    BED_Init(&p->bed);
+    p->rng = 2463534242u ^ (i * 2654435761u);
+    if (!p->rng)
+    {
+        p->rng = 1;
+    }
+    p->patient = 45 + 60 * uniform(&p->rng);
+    p->base_temp = 36.0 + 0.4 * uniform(&p->rng); // one ADC code (0.49 C) below the alarm at most
+    p->ambient = 14 + 6 * uniform(&p->rng);
+    p->room = p->sensor = p->ambient;
+    p->bed.heater_threshold = 20 + xorshift(&p->rng) % 5;
+    p->bed.mode_new = p->bed.mode_old = xorshift(&p->rng) & 1;
+}
+
+// ADC code of a temperature with +-1 code of noise, converted like the firmware does
+static temp_dC_t sensed_temp(Bed_t *p, const SENSOR_Channel_t *ch, double c)
+{
+    int code = (int)lround(c / C_PER_CODE) + (int)(xorshift(&p->rng) % 3) - 1;
+    return SENSOR_Convert(ch, code < 0 ? 0 : (code > 1023 ? 1023 : code));
+}
+
+static void bed_step(Bed_t *p, unsigned long step, Stats_t *st)
+{
+    double weight;
+    u8 changed;
+
+    // WEIGHT: the patient leaves now and then, visitors sit on the bed
+    if (p->away)
+    {
+        p->away--;
+    }
+    else if (uniform(&p->rng) < LEAVE_PER_STEP)
+    {
+        p->away = (unsigned)((300 + 1500 * uniform(&p->rng)) / STEP_S);
+    }
+    if (p->visit)
+    {
+        p->visit--;
+    }
+    else if (uniform(&p->rng) < VISIT_PER_STEP)
+    {
+        p->visit = (unsigned)((20 + 40 * uniform(&p->rng)) / STEP_S);
+        p->visitor = 60 + 40 * uniform(&p->rng);
+    }
+    weight = (p->away ? 0 : p->patient) + (p->visit ? p->visitor : 0);
+
+    // two load cell samples per step for the bed exit detector
+    BED_Weigh(&p->bed, (u16)(weight + 3 * uniform(&p->rng)));
+    weight += 3 * uniform(&p->rng);
+    BED_Weigh(&p->bed, (u16)weight);
+
+    // BODY: a fever climbs ~1 C in 10 minutes to its peak, and falls back in the last 40 minutes
+    if (p->fever_steps)
+    {
+        p->fever_steps--;
+        if (p->fever_steps < (unsigned)(2400 / STEP_S))
+        {
+            p->fever = p->fever > 0.0005 ? p->fever - 0.0005 : 0;
+        }
+        else if (p->fever < p->fever_peak)
+        {
+            p->fever += 0.00017;
+        }
+    }
+    else if (uniform(&p->rng) < FEVER_PER_STEP)
+    {
+        p->fever_steps = (unsigned)(7200 / STEP_S);
+        p->fever_peak = 1.0 + 2.0 * uniform(&p->rng);
+    }
+    else
+    {
+        p->fever = 0;
+    }
+
+    // ROOM: first order room heated by the relay, lagging sensor
+    p->room += (p->ambient + HEATER_RISE * p->bed.heater_state - p->room) * (STEP_S / ROOM_TAU_S);
+    p->sensor += (p->room - p->sensor) * (STEP_S / SENSOR_TAU_S);
+
+    changed = BED_Sense(&p->bed, (u16)weight, sensed_temp(p, &SENSOR_BodyTemp, p->base_temp + p->fever),
+                        sensed_temp(p, &SENSOR_RoomTemp, p->sensor));
+    for (unsigned s = 0; s < ALARM_SLOTS; s++)
+    {
+        if (changed & p->bed.alarms & (1 << s))
+        {
+            st->alarms[s]++;
+        }
+    }
+    BED_Heater(&p->bed);
+    if (step % STEPS_PER_CONTROL == 0)
+    {
+        if (uniform(&p->rng) < MODE_PER_SECOND)
+        {
+            p->bed.mode_new ^= 1;
+        }
+        BED_Control(&p->bed);
+    }
+}
+
+static void run_task(Worker_t *w, int task)
+{
+    unsigned first = task * W.chunk;
+    unsigned last = first + W.chunk < W.nbeds ? first + W.chunk : W.nbeds;
+    struct timespec prev, now;
+
+    clock_gettime(CLOCK_MONOTONIC, &prev);
+    for (unsigned i = first; i < last; i++)
+    {
+        for (unsigned k = 0; k < W.round_steps; k++)
+        {
+            bed_step(&W.beds[i], W.round_first + k, &w->st);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        w->st.service[hist_bucket(ns_since(&prev, &now) / W.round_steps)]++;
+        w->st.latency[hist_bucket(ns_since(&W.round_start, &now))]++;
+        prev = now;
+    }
+    w->st.steps += (last - first) * W.round_steps;
+    w->st.tasks++;
+}
+
+static void *worker(void *arg)
+{
+    Worker_t *w = arg;
+
+    for (;;)
+    {
+        // round setup by one thread, then everyone starts together
+        if (pthread_barrier_wait(&W.barrier) == PTHREAD_BARRIER_SERIAL_THREAD)
+        {
+            W.round_first += W.round_steps;
+            W.round_steps = W.round_first + W.per_round <= W.steps ? W.per_round : W.steps - W.round_first;
+            W.done = W.round_steps == 0;
+            atomic_store(&W.remaining, W.ntasks);
+            clock_gettime(CLOCK_MONOTONIC, &W.round_start);
+        }
+        pthread_barrier_wait(&W.barrier);
+        if (W.done)
+        {
+            return 0;
+        }
+
+        // own share of the tasks, the same beds every round
+        for (unsigned t = w->id; t < W.ntasks; t += W.nthreads)
+        {
+            dq_push(&w->dq, (int)t);
+        }
+
+        while (atomic_load_explicit(&W.remaining, memory_order_acquire) > 0)
+        {
+            int task = dq_take(&w->dq);
+            if (task < 0 && W.nthreads > 1)
+            {
+                Worker_t *v = &W.workers[xorshift(&w->rng) % W.nthreads];
+                if (v != w)
+                {
+                    task = dq_steal(&v->dq);
+                    if (task >= 0)
+                    {
+                        w->st.steals++;
+                    }
+                }
+            }
+            if (task >= 0)
+            {
+                run_task(w, task);
+                atomic_fetch_sub_explicit(&W.remaining, 1, memory_order_release);
+            }
+            else
+            {
+                sched_yield();
+            }
+        }
+    }
+}
+
+static unsigned long percentile(const unsigned long *h, double p)
+{
+    unsigned long total = 0, seen = 0;
+
+    for (unsigned b = 0; b < HIST_BUCKETS; b++)
+    {
+        total += h[b];
+    }
+    for (unsigned b = 0; b < HIST_BUCKETS; b++)
+    {
+        seen += h[b];
+        if (seen && seen >= p * total)
+        {
+            return hist_upper(b);
+        }
+    }
+    return 0;
+}
+
+static void run(unsigned nthreads, double seconds)
+{
+    Stats_t sum;
+    struct timespec t0, t1;
+    double wall;
+    long cap = 1;
+
+    W.nthreads = nthreads;
+    W.steps = (unsigned long)(seconds / STEP_S);
+    W.ntasks = (W.nbeds + W.chunk - 1) / W.chunk;
+    W.round_first = 0;
+    W.round_steps = 0;
+    W.beds = malloc(sizeof(*W.beds) * W.nbeds);
+    for (unsigned i = 0; i < W.nbeds; i++)
+    {
+        bed_init(&W.beds[i], i);
+    }
+    while (cap < W.ntasks)
+    {
+        cap <<= 1;
+    }
+    W.workers = aligned_alloc(CACHE_LINE, sizeof(*W.workers) * nthreads);
+    memset(W.workers, 0, sizeof(*W.workers) * nthreads);
+    pthread_barrier_init(&W.barrier, 0, nthreads);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (unsigned i = 0; i < nthreads; i++)
+    {
+        W.workers[i].id = i;
+        W.workers[i].rng = 0x9e3779b9u * (i + 1);
+        dq_init(&W.workers[i].dq, cap);
+        pthread_create(&W.workers[i].thread, 0, worker, &W.workers[i]);
+    }
+    memset(&sum, 0, sizeof(sum));
+    for (unsigned i = 0; i < nthreads; i++)
+    {
+        Stats_t *st = &W.workers[i].st;
+        pthread_join(W.workers[i].thread, 0);
+        sum.steps += st->steps;
+        sum.tasks += st->tasks;
+        sum.steals += st->steals;
+        for (unsigned s = 0; s < ALARM_SLOTS; s++)
+        {
+            sum.alarms[s] += st->alarms[s];
+        }
+        for (unsigned b = 0; b < HIST_BUCKETS; b++)
+        {
+            sum.service[b] += st->service[b];
+            sum.latency[b] += st->latency[b];
+        }
+        free(W.workers[i].dq.buf);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    wall = ns_since(&t0, &t1) / 1e9;
+
+    printf("%2u threads: %.3f s wall, %.2f M bed steps/s, %.0f beds in real time, %.1f%% tasks stolen\n", nthreads,
+           wall, sum.steps / wall / 1e6, sum.steps / wall * STEP_S, sum.tasks ? 100.0 * sum.steals / sum.tasks : 0.0);
+    printf("            decision per bed step  p50 %lu ns  p99 %lu ns  max %lu ns\n", percentile(sum.service, 0.5),
+           percentile(sum.service, 0.99), percentile(sum.service, 1.0));
+    printf("            round start to decided p50 %lu us  p99 %lu us  max %lu us\n",
+           percentile(sum.latency, 0.5) / 1000, percentile(sum.latency, 0.99) / 1000,
+           percentile(sum.latency, 1.0) / 1000);
+    printf("            alarms raised: weight %lu, bed exit %lu, fever %lu\n", sum.alarms[ALARM_SLOT_WEIGHT],
+           sum.alarms[ALARM_SLOT_EXIT], sum.alarms[ALARM_SLOT_FEVER]);
+
+    pthread_barrier_destroy(&W.barrier);
+    free(W.workers);
+    free(W.beds);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned threads = (unsigned)sysconf(_SC_NPROCESSORS_ONLN);
+    double seconds = 600;
+    int opt, sweep = 0;
+
+    W.nbeds = 4096;
+    W.chunk = 32;
+    W.per_round = 10;
+    while ((opt = getopt(argc, argv, "b:t:s:c:r:S")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            W.nbeds = (unsigned)strtoul(optarg, 0, 10);
+            break;
+        case 't':
+            threads = (unsigned)strtoul(optarg, 0, 10);
+            break;
+        case 's':
+            seconds = strtod(optarg, 0);
+            break;
+        case 'c':
+            W.chunk = (unsigned)strtoul(optarg, 0, 10);
+            break;
+        case 'r':
+            W.per_round = (unsigned)strtoul(optarg, 0, 10);
+            break;
+        case 'S':
+            sweep = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-b beds] [-t threads] [-s ward seconds] [-c beds per task] [-r steps per round] [-S]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (!W.nbeds || !W.chunk || !W.per_round || !threads)
+    {
+        fprintf(stderr, "beds, threads, chunk and round must be above 0\n");
+        return 2;
+    }
+
+    printf("wardsim: %u beds, %.0f s of ward time (%lu steps of 100ms), %u beds per task, %lu steps per round\n",
+           W.nbeds, seconds, (unsigned long)(seconds / STEP_S), W.chunk, W.per_round);
+    if (sweep)
+    {
+        for (unsigned t = 1; t < threads; t *= 2)
+        {
+            run(t, seconds);
+        }
+    }
+    run(threads, seconds);
+    return 0;
+}